@@ -0,0 +1,81 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "addrman.h"
+#include "random.h"
+
+#include <vector>
+
+// Size of the address table the benchmarks operate on
+static const size_t ADDRMAN_BENCH_ADDRESSES = 100000;
+
+static std::vector<CAddress> vAddresses;
+static std::vector<CNetAddr> vSources;
+
+static void CreateAddresses()
+{
+    if (!vAddresses.empty())
+        return;
+
+    seed_insecure_rand(true);
+    while (vAddresses.size() < ADDRMAN_BENCH_ADDRESSES) {
+        struct in_addr ip;
+        ip.s_addr = htonl(insecure_rand());
+        CAddress addr(CService(CNetAddr(ip), 9857), NODE_NETWORK);
+        if (!addr.IsRoutable())
+            continue;
+        addr.nTime = GetAdjustedTime() - 60 * 60;
+        vAddresses.push_back(addr);
+    }
+    for (int i = 0; i < 256; i++) {
+        struct in_addr ip;
+        ip.s_addr = htonl(0x50000000 | (i << 16) | 1);
+        vSources.push_back(CNetAddr(ip));
+    }
+}
+
+static void FillAddrMan(CAddrMan& addrman)
+{
+    for (size_t i = 0; i < vAddresses.size(); i++)
+        addrman.Add(vAddresses[i], vSources[i % vSources.size()]);
+}
+
+static void AddrManAdd(benchmark::State& state)
+{
+    CreateAddresses();
+
+    while (state.KeepRunning()) {
+        CAddrMan addrman;
+        FillAddrMan(addrman);
+    }
+}
+
+static void AddrManSelect(benchmark::State& state)
+{
+    CreateAddresses();
+    CAddrMan addrman;
+    FillAddrMan(addrman);
+
+    while (state.KeepRunning()) {
+        CAddrInfo addr = addrman.Select();
+        assert(addr.GetPort() > 0);
+    }
+}
+
+static void AddrManGood(benchmark::State& state)
+{
+    CreateAddresses();
+
+    while (state.KeepRunning()) {
+        CAddrMan addrman;
+        FillAddrMan(addrman);
+        for (size_t i = 0; i < vAddresses.size(); i += 10)
+            addrman.Good(vAddresses[i]);
+    }
+}
+
+BENCHMARK(AddrManAdd);
+BENCHMARK(AddrManSelect);
+BENCHMARK(AddrManGood);
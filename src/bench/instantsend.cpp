@@ -0,0 +1,97 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "activemasternode.h"
+#include "instantx.h"
+#include "masternodeman.h"
+#include "random.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <iostream>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+// Number of lock votes checked per run and masternodes signing them
+static const int VOTE_BENCH_COUNT = 10000;
+static const int VOTE_BENCH_MASTERNODES = 100;
+
+static std::vector<CTxLockVote> vVotes;
+
+static void CreateVotes()
+{
+    if (!vVotes.empty())
+        return;
+
+    // every run has to recover the public keys, don't let the message signature cache answer
+    mapArgs["-maxmsgsigcachesize"] = "0";
+
+    std::vector<CKey> vKeys;
+    std::vector<COutPoint> vOutpoints;
+    for (int i = 0; i < VOTE_BENCH_MASTERNODES; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        struct in_addr ip;
+        ip.s_addr = htonl(0x01000000 | i);
+        CTxIn vin(COutPoint(GetRandHash(), 0));
+        CMasternode mn(CService(CNetAddr(ip), 9857), vin, key.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION);
+        mnodeman.Add(mn);
+        vKeys.push_back(key);
+        vOutpoints.push_back(vin.prevout);
+    }
+
+    for (int i = 0; i < VOTE_BENCH_COUNT; i++) {
+        activeMasternode.keyMasternode = vKeys[i % vKeys.size()];
+        activeMasternode.pubKeyMasternode = activeMasternode.keyMasternode.GetPubKey();
+        CTxLockVote vote(GetRandHash(), COutPoint(GetRandHash(), 0), vOutpoints[i % vOutpoints.size()]);
+        bool fSigned = vote.Sign();
+        assert(fSigned);
+        vVotes.push_back(vote);
+    }
+}
+
+static void CheckVotes(size_t nBegin, size_t nEnd)
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        bool fValid = vVotes[i].CheckSignature();
+        assert(fValid);
+    }
+}
+
+// Signature checks of a burst of lock votes, the part of vote processing done by the vote threads
+static void RunVoteChecks(benchmark::State& state, int nThreads)
+{
+    CreateVotes();
+
+    int64_t nVotes = 0;
+    int64_t nTimeTotal = 0;
+    while (state.KeepRunning()) {
+        int64_t nTimeStart = GetTimeMicros();
+        size_t nChunkSize = (vVotes.size() + nThreads - 1) / nThreads;
+        boost::thread_group threadGroup;
+        for (size_t nBegin = 0; nBegin < vVotes.size(); nBegin += nChunkSize)
+            threadGroup.create_thread(boost::bind(&CheckVotes, nBegin, std::min(nBegin + nChunkSize, vVotes.size())));
+        threadGroup.join_all();
+        nTimeTotal += GetTimeMicros() - nTimeStart;
+        nVotes += vVotes.size();
+    }
+
+    if (nTimeTotal > 0)
+        std::cout << "# " << nThreads << " thread(s): " << nVotes * 1000000 / nTimeTotal << " votes/sec\n";
+}
+
+static void InstantSendVotesOneThread(benchmark::State& state)
+{
+    RunVoteChecks(state, 1);
+}
+
+static void InstantSendVotesVoteThreads(benchmark::State& state)
+{
+    RunVoteChecks(state, std::min(std::max(GetNumCores(), 1), MAX_INSTANTSEND_VOTE_THREADS));
+}
+
+BENCHMARK(InstantSendVotesOneThread);
+BENCHMARK(InstantSendVotesVoteThreads);
@@ -0,0 +1,93 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "masternodeman.h"
+#include "random.h"
+
+#include <vector>
+
+// Size of the masternode list the benchmarks operate on
+static const int MASTERNODE_BENCH_COUNT = 5000;
+
+static std::vector<CMasternode> vMasternodes;
+
+static CPubKey RandomPubKey()
+{
+    std::vector<unsigned char> vch(33);
+    vch[0] = 0x02;
+    for (size_t i = 1; i < vch.size(); i++)
+        vch[i] = insecure_rand();
+    return CPubKey(vch.begin(), vch.end());
+}
+
+static void CreateMasternodes()
+{
+    if (!vMasternodes.empty())
+        return;
+
+    seed_insecure_rand(true);
+    for (int i = 0; i < MASTERNODE_BENCH_COUNT; i++) {
+        struct in_addr ip;
+        ip.s_addr = htonl(0x01000000 | i);
+        CTxIn vin(COutPoint(GetRandHash(), 0));
+        vMasternodes.push_back(CMasternode(CService(CNetAddr(ip), 9857), vin, RandomPubKey(), RandomPubKey(), PROTOCOL_VERSION));
+    }
+}
+
+static void FillMasternodeMan(CMasternodeMan& mnman)
+{
+    for (size_t i = 0; i < vMasternodes.size(); i++)
+        mnman.Add(vMasternodes[i]);
+}
+
+// Lookup done for every mnp, IS vote and payment vote
+static void MasternodeManFindVin(benchmark::State& state)
+{
+    CreateMasternodes();
+    CMasternodeMan mnman;
+    FillMasternodeMan(mnman);
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        masternode_info_t info = mnman.GetMasternodeInfo(vMasternodes[i++ % vMasternodes.size()].vin);
+        assert(info.fInfoValid);
+    }
+}
+
+// Lookup done for mnb and governance votes signed with the masternode key
+static void MasternodeManFindPubKey(benchmark::State& state)
+{
+    CreateMasternodes();
+    CMasternodeMan mnman;
+    FillMasternodeMan(mnman);
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        masternode_info_t info = mnman.GetMasternodeInfo(vMasternodes[i++ % vMasternodes.size()].pubKeyMasternode);
+        assert(info.fInfoValid);
+    }
+}
+
+// Lookup done when checking block payees
+static void MasternodeManFindPayee(benchmark::State& state)
+{
+    CreateMasternodes();
+    CMasternodeMan mnman;
+    FillMasternodeMan(mnman);
+
+    std::vector<CScript> vPayees;
+    for (size_t i = 0; i < vMasternodes.size(); i++)
+        vPayees.push_back(GetScriptForDestination(vMasternodes[i].pubKeyCollateralAddress.GetID()));
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        CMasternode* pmn = mnman.Find(vPayees[i++ % vPayees.size()]);
+        assert(pmn);
+    }
+}
+
+BENCHMARK(MasternodeManFindVin);
+BENCHMARK(MasternodeManFindPubKey);
+BENCHMARK(MasternodeManFindPayee);
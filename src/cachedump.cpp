@@ -0,0 +1,89 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cachedump.h"
+#include "flat-database.h"
+#include "governance.h"
+#include "masternode-payments.h"
+#include "masternodeman.h"
+#include "netfulfilledman.h"
+#include "scheduler.h"
+#include "sync.h"
+#include "util.h"
+
+static CCriticalSection cs_cachedump;
+static int64_t nCacheDumpInterval = 0;
+static std::map<std::string, CCacheDumpStats> mapCacheDumpStats;
+// hash of the last snapshot written, by file name
+static std::map<std::string, uint256> mapLastSnapshotHash;
+// cache generation of the object when its last snapshot was written, by file name
+static std::map<std::string, uint64_t> mapLastGeneration;
+
+template<typename T>
+static void DumpCache(T& objToSave, const std::string& strFilename, const std::string& strMagicMessage)
+{
+    AssertLockHeld(cs_cachedump);
+
+    int64_t nStart = GetTimeMillis();
+
+    CCacheDumpStats& stats = mapCacheDumpStats[strFilename];
+    // nothing changed since the last snapshot, don't even take the object's locks
+    uint64_t nGeneration = objToSave.GetCacheGeneration();
+    if (mapLastGeneration.count(strFilename) && mapLastGeneration[strFilename] == nGeneration) {
+        stats.fSuccess = true;
+        stats.nTime = GetTime();
+        stats.nDurationMillis = GetTimeMillis() - nStart;
+        stats.nUnchanged++;
+        LogPrint("cachedump", "DumpCache -- %s: unchanged since generation %d\n", strFilename, nGeneration);
+        return;
+    }
+
+    CFlatDB<T> flatdb(strFilename, strMagicMessage);
+    bool fWritten = false;
+    stats.fSuccess = flatdb.DumpSnapshot(objToSave, mapLastSnapshotHash[strFilename], stats.nSize, fWritten);
+    // changes made while the snapshot was taken bumped the generation past the one read above
+    if (stats.fSuccess)
+        mapLastGeneration[strFilename] = nGeneration;
+    stats.nTime = GetTime();
+    stats.nDurationMillis = GetTimeMillis() - nStart;
+    if (fWritten)
+        stats.nWritten++;
+    else if (stats.fSuccess)
+        stats.nUnchanged++;
+
+    LogPrint("cachedump", "DumpCache -- %s: %s, %d bytes  %dms\n", strFilename,
+             !stats.fSuccess ? "failed" : fWritten ? "written" : "unchanged", stats.nSize, stats.nDurationMillis);
+}
+
+void DumpCaches()
+{
+    LOCK(cs_cachedump);
+    DumpCache(mnodeman, "mncache.dat", "magicMasternodeCache");
+    DumpCache(mnpayments, "mnpayments.dat", "magicMasternodePaymentsCache");
+    DumpCache(governance, "governance.dat", "magicGovernanceCache");
+    DumpCache(netfulfilledman, "netfulfilled.dat", "magicFulfilledCache");
+}
+
+void StartCacheDumps(CScheduler& scheduler, int64_t nInterval)
+{
+    {
+        LOCK(cs_cachedump);
+        nCacheDumpInterval = nInterval;
+    }
+    if (nInterval <= 0)
+        return;
+    scheduler.scheduleEvery(&DumpCaches, nInterval);
+}
+
+int64_t GetCacheDumpInterval()
+{
+    LOCK(cs_cachedump);
+    return nCacheDumpInterval;
+}
+
+std::map<std::string, CCacheDumpStats> GetCacheDumpStats()
+{
+    LOCK(cs_cachedump);
+    return mapCacheDumpStats;
+}
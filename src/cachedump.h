@@ -0,0 +1,45 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CACHEDUMP_H
+#define CACHEDUMP_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+
+class CScheduler;
+
+/** Default for -cachedumpinterval, in seconds */
+static const int64_t DEFAULT_CACHE_DUMP_INTERVAL = 15 * 60;
+
+/** What happened to one cache file during the periodic dumps */
+struct CCacheDumpStats
+{
+    int64_t nTime;           // time of the last dump attempt
+    int64_t nDurationMillis; // how long it took, including the snapshot
+    uint64_t nSize;          // size of the last snapshot
+    bool fSuccess;           // whether the last attempt succeeded
+    int nWritten;            // dumps that wrote the file
+    int nUnchanged;          // dumps that had nothing new to write
+
+    CCacheDumpStats() : nTime(0), nDurationMillis(0), nSize(0), fSuccess(false), nWritten(0), nUnchanged(0) {}
+};
+
+/**
+ * Snapshot the masternode list, payment votes, governance objects and fulfilled requests
+ * into memory and write the files whose contents changed since the previous dump.
+ * Managers whose cache generation didn't change are skipped without locking them,
+ * the others are only locked while a copy of their state is taken.
+ */
+void DumpCaches();
+
+/** Run DumpCaches() every nInterval seconds on the scheduler thread, 0 disables it */
+void StartCacheDumps(CScheduler& scheduler, int64_t nInterval);
+
+int64_t GetCacheDumpInterval();
+/** Statistics of the periodic dumps by file name */
+std::map<std::string, CCacheDumpStats> GetCacheDumpStats();
+
+#endif
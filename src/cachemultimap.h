@@ -60,7 +60,7 @@ public:
           mapIndex()
     {}
 
-    CacheMultiMap(const CacheMap<K,V>& other)
+    CacheMultiMap(const CacheMultiMap<K,V,Size>& other)
         : nMaxSize(other.nMaxSize),
           nCurrentSize(other.nCurrentSize),
           listItems(other.listItems),
@@ -195,7 +195,7 @@ public:
         return listItems;
     }
 
-    CacheMap<K,V>& operator=(const CacheMap<K,V>& other)
+    CacheMultiMap<K,V,Size>& operator=(const CacheMultiMap<K,V,Size>& other)
     {
         nMaxSize = other.nMaxSize;
         nCurrentSize = other.nCurrentSize;
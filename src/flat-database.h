@@ -9,10 +9,105 @@
 #include "clientversion.h"
 #include "hash.h"
 #include "streams.h"
+#include "sync.h"
 #include "util.h"
 
 #include <boost/filesystem.hpp>
 
+/** Version of the file layout written by CFlatDB, following the magic numbers */
+static const int FLATDB_FORMAT_VERSION = 2;
+
+/**
+ * A member of an object stored with CFlatDB, written with its own size and checksum.
+ * On load, a section that fails verification is skipped and leaves the member as is,
+ * so one damaged section doesn't invalidate the whole file. Members which only make
+ * sense together with others can have the failure reported, see FLATDB_SECTION_CHECKED.
+ */
+template<typename T>
+class CFlatDBSection
+{
+private:
+    T& obj;
+    bool* pfDamaged;
+
+public:
+    explicit CFlatDBSection(T& objIn, bool* pfDamagedIn = NULL) : obj(objIn), pfDamaged(pfDamagedIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return sizeof(uint64_t) + ::GetSerializeSize(obj, nType, nVersion) + sizeof(uint256);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        uint64_t nSize = ::GetSerializeSize(obj, nType, nVersion);
+        s << nSize;
+        // stream the member straight through, hashing it on the way
+        CHashingWriter<Stream> hashout(&s);
+        hashout << obj;
+        s << hashout.GetHash();
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        uint64_t nSize;
+        s >> nSize;
+        // read in chunks, a damaged size must not make us allocate everything at once
+        std::vector<char> vchData;
+        while (vchData.size() < nSize) {
+            size_t nPos = vchData.size();
+            vchData.resize(nPos + std::min<uint64_t>(nSize - nPos, 1 << 20));
+            s.read(&vchData[nPos], vchData.size() - nPos);
+        }
+        uint256 hashIn;
+        s >> hashIn;
+
+        if (hashIn != Hash(vchData.begin(), vchData.end())) {
+            LogPrintf("CFlatDBSection::Unserialize -- Checksum mismatch, skipping section of %d bytes\n", nSize);
+            if (pfDamaged) *pfDamaged = true;
+            return;
+        }
+
+        CDataStream ssData(vchData, nType, nVersion);
+        ssData >> obj;
+    }
+};
+
+template<typename T>
+CFlatDBSection<T> WrapFlatDBSection(T& obj, bool* pfDamaged = NULL) { return CFlatDBSection<T>(obj, pfDamaged); }
+
+#define FLATDB_SECTION(obj) REF(WrapFlatDBSection(REF(obj)))
+/** Like FLATDB_SECTION, but sets fDamaged if the section is skipped on load */
+#define FLATDB_SECTION_CHECKED(obj, fDamaged) REF(WrapFlatDBSection(REF(obj), &(fDamaged)))
+
+/**
+ * Change counter of an object stored with CFlatDB. The object bumps it whenever the state it
+ * writes changes, so periodic dumps can tell it is unchanged without taking the object's locks.
+ */
+class CFlatDBGeneration
+{
+private:
+    mutable CCriticalSection cs;
+    uint64_t nGeneration;
+
+public:
+    CFlatDBGeneration() : nGeneration(1) {}
+
+    void Bump()
+    {
+        LOCK(cs);
+        nGeneration++;
+    }
+
+    uint64_t Get() const
+    {
+        LOCK(cs);
+        return nGeneration;
+    }
+};
+
 /** 
 *   Generic Dumping and Loading
 *   ---------------------------
@@ -37,42 +132,41 @@ private:
     std::string strFilename;
     std::string strMagicMessage;
 
-    bool Write(const T& objToSave)
+    /** Write the file header followed by data, either the object itself or a snapshot of it */
+    template<typename Data>
+    bool Write(const Data& data)
     {
-        // LOCK(objToSave.cs);
-
-        int64_t nStart = GetTimeMillis();
-
-        // serialize, checksum data up to that point, then append checksum
-        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-        ssObj << strMagicMessage; // specific magic message for this type of object
-        ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-        ssObj << objToSave;
-        uint256 hash = Hash(ssObj.begin(), ssObj.end());
-        ssObj << hash;
+        // write to a temporary file first, so a failed dump never replaces a good one
+        boost::filesystem::path pathTmp = pathDB.string() + ".new";
 
         // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-        // Write and commit header, data
+        // Write header and data, the data is checksummed per section
         try {
-            fileout << ssObj;
+            fileout << strMagicMessage; // specific magic message for this type of object
+            fileout << FLATDATA(Params().MessageStart()); // network specific magic number
+            // old files have a compact size here, which never starts with 0xff
+            fileout << (unsigned char)0xff;
+            fileout << FLATDB_FORMAT_VERSION;
+            fileout << data;
         }
         catch (std::exception &e) {
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
+        FileCommit(fileout.Get());
         fileout.fclose();
 
-        LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
-        LogPrintf("     %s\n", objToSave.ToString());
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Rename-into-place failed", __func__);
 
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    ReadResult Read(T& objToLoad)
     {
         //LOCK(objToLoad.cs);
 
@@ -86,43 +180,11 @@ private:
             return FileError;
         }
 
-        // use file size to size memory buffer
-        int fileSize = boost::filesystem::file_size(pathDB);
-        int dataSize = fileSize - sizeof(uint256);
-        // Don't try to resize to a negative number if file is small
-        if (dataSize < 0)
-            dataSize = 0;
-        std::vector<unsigned char> vchData;
-        vchData.resize(dataSize);
-        uint256 hashIn;
-
-        // read data and checksum from file
-        try {
-            filein.read((char *)&vchData[0], dataSize);
-            filein >> hashIn;
-        }
-        catch (std::exception &e) {
-            error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            return HashReadError;
-        }
-        filein.fclose();
-
-        CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-        // verify stored checksum matches input data
-        uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-        if (hashIn != hashTmp)
-        {
-            error("%s: Checksum mismatch, data corrupted", __func__);
-            return IncorrectHash;
-        }
-
-
         unsigned char pchMsgTmp[4];
         std::string strMagicMessageTmp;
         try {
             // de-serialize file header (file specific magic message) and ..
-            ssObj >> strMagicMessageTmp;
+            filein >> strMagicMessageTmp;
 
             // ... verify the message matches predefined one
             if (strMagicMessage != strMagicMessageTmp)
@@ -133,7 +195,7 @@ private:
 
 
             // de-serialize file header (network specific magic number) and ..
-            ssObj >> FLATDATA(pchMsgTmp);
+            filein >> FLATDATA(pchMsgTmp);
 
             // ... verify the network matches ours
             if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
@@ -142,22 +204,37 @@ private:
                 return IncorrectMagicNumber;
             }
 
-            // de-serialize data into T object
-            ssObj >> objToLoad;
+            // files written before sections were introduced are recreated
+            unsigned char chMarker;
+            int nFormatVersion;
+            filein >> chMarker;
+            if (chMarker != 0xff)
+            {
+                error("%s: Old file format", __func__);
+                return IncorrectFormat;
+            }
+            filein >> nFormatVersion;
+            if (nFormatVersion != FLATDB_FORMAT_VERSION)
+            {
+                error("%s: Unknown file format version %d", __func__, nFormatVersion);
+                return IncorrectFormat;
+            }
+
+            // de-serialize data into T object, section by section
+            filein >> objToLoad;
         }
         catch (std::exception &e) {
             objToLoad.Clear();
             error("%s: Deserialize or I/O error - %s", __func__, e.what());
             return IncorrectFormat;
         }
+        filein.fclose();
 
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
-        if(!fDryRun) {
-            LogPrintf("%s: Cleaning....\n", __func__);
-            objToLoad.CheckAndRemove();
-            LogPrintf("     %s\n", objToLoad.ToString());
-        }
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
 
         return Ok;
     }
@@ -197,29 +274,44 @@ public:
     {
         int64_t nStart = GetTimeMillis();
 
-        LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
+        LogPrintf("Writting info to %s...\n", strFilename);
+        if (!Write(objToSave))
+            return false;
+        LogPrintf("     %s\n", objToSave.ToString());
+        LogPrintf("%s dump finished  %dms\n", strFilename, GetTimeMillis() - nStart);
 
-        // there was an error and it was not an error on file opening => do not proceed
-        if (readResult == FileError)
-            LogPrintf("Missing file %s, will try to recreate\n", strFilename);
-        else if (readResult != Ok)
-        {
-            LogPrintf("Error reading %s: ", strFilename);
-            if(readResult == IncorrectFormat)
-                LogPrintf("%s: Magic is ok but data has invalid format, will try to recreate\n", __func__);
-            else
-            {
-                LogPrintf("%s: File format is unknown or invalid, please fix it manually\n", __func__);
-                return false;
-            }
+        return true;
+    }
+
+    /**
+     * Serialize objToSave into memory and write the snapshot out unless it is identical
+     * to the one hashed in hashLastSnapshot. Objects that copy their state under their
+     * locks and serialize the copy, like the masternode and governance managers, only
+     * hold their locks while the copy is taken.
+     * The size of the snapshot is returned in nSizeRet, fWrittenRet tells if it was written.
+     */
+    bool DumpSnapshot(T& objToSave, uint256& hashLastSnapshot, uint64_t& nSizeRet, bool& fWrittenRet)
+    {
+        fWrittenRet = false;
+
+        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+        try {
+            ssObj << objToSave;
         }
+        catch (std::exception &e) {
+            return error("%s: Serialize error - %s", __func__, e.what());
+        }
+        nSizeRet = ssObj.size();
 
-        LogPrintf("Writting info to %s...\n", strFilename);
-        Write(objToSave);
-        LogPrintf("%s dump finished  %dms\n", strFilename, GetTimeMillis() - nStart);
+        uint256 hash = Hash(ssObj.begin(), ssObj.end());
+        if (hash == hashLastSnapshot)
+            return true;
+
+        if (!Write(ssObj))
+            return false;
 
+        hashLastSnapshot = hash;
+        fWrittenRet = true;
         return true;
     }
 
@@ -140,6 +140,7 @@ bool CGovernanceTriggerManager::AddNewTrigger(uint256 nHash)
 
     DBG( cout << "CGovernanceTriggerManager::AddNewTrigger: Inserting trigger" << endl; );
     mapTrigger.insert(std::make_pair(nHash, pSuperblock));
+    mapTriggerHeights[pSuperblock->GetBlockStart()].insert(nHash);
 
     DBG( cout << "CGovernanceTriggerManager::AddNewTrigger: End" << endl; );
 
@@ -210,6 +211,7 @@ void CGovernanceTriggerManager::CleanAndRemove()
                             LogPrint("gobject", "CGovernanceTriggerManager::CleanAndRemove -- Expiring outdated object: %s\n", pgovobj->GetHash().ToString());
                             pgovobj->fExpired = true;
                             pgovobj->nDeletionTime = GetAdjustedTime();
+                            governance.MarkCacheChanged();
                         }
                     }
                 }
@@ -231,6 +233,15 @@ void CGovernanceTriggerManager::CleanAndRemove()
                      << endl;
                );
             LogPrint("gobject", "CGovernanceTriggerManager::CleanAndRemove -- Removing trigger object\n");
+            if(pSuperblock) {
+                height_trigger_m_it itHeight = mapTriggerHeights.find(pSuperblock->GetBlockStart());
+                if(itHeight != mapTriggerHeights.end()) {
+                    itHeight->second.erase(it->first);
+                    if(itHeight->second.empty()) {
+                        mapTriggerHeights.erase(itHeight);
+                    }
+                }
+            }
             mapTrigger.erase(it++);
         }
         else  {
@@ -244,28 +255,35 @@ void CGovernanceTriggerManager::CleanAndRemove()
 /**
 *   Get Active Triggers
 *
-*   - Look through triggers and scan for active ones
-*   - Return the triggers in a list
+*   - Look up the triggers for a superblock height
+*   - Return the ones which still have a governance object in a list
 */
 
-std::vector<CSuperblock_sptr> CGovernanceTriggerManager::GetActiveTriggers()
+std::vector<CSuperblock_sptr> CGovernanceTriggerManager::GetActiveTriggers(int nBlockHeight)
 {
     AssertLockHeld(governance.cs);
     std::vector<CSuperblock_sptr> vecResults;
 
     DBG( cout << "GetActiveTriggers: mapTrigger.size() = " << mapTrigger.size() << endl; );
 
+    height_trigger_m_it itHeight = mapTriggerHeights.find(nBlockHeight);
+    if(itHeight == mapTriggerHeights.end()) {
+        return vecResults;
+    }
+
     // LOOK AT THESE OBJECTS AND COMPILE A VALID LIST OF TRIGGERS
-    trigger_m_it it = mapTrigger.begin();
-    while(it != mapTrigger.end()) {
+    BOOST_FOREACH(const uint256& nHash, itHeight->second) {
+        trigger_m_it it = mapTrigger.find(nHash);
+        if(it == mapTrigger.end()) {
+            continue;
+        }
 
-        CGovernanceObject* pObj = governance.FindGovernanceObject((*it).first);
+        CGovernanceObject* pObj = governance.FindGovernanceObject(nHash);
 
         if(pObj) {
             DBG( cout << "GetActiveTriggers: pObj->GetDataAsString() = " << pObj->GetDataAsString() << endl; );
             vecResults.push_back(it->second);
         }
-        ++it;
     }
 
     DBG( cout << "GetActiveTriggers: vecResults.size() = " << vecResults.size() << endl; );
@@ -287,8 +305,8 @@ bool CSuperblockManager::IsSuperblockTriggered(int nBlockHeight)
     }
 
     LOCK(governance.cs);
-    // GET ALL ACTIVE TRIGGERS
-    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
+    // GET ALL ACTIVE TRIGGERS FOR THIS HEIGHT
+    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers(nBlockHeight);
 
     LogPrint("gobject", "CSuperblockManager::IsSuperblockTriggered -- vecTriggers.size() = %d\n", vecTriggers.size());
 
@@ -351,7 +369,7 @@ bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int
     }
 
     AssertLockHeld(governance.cs);
-    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
+    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers(nBlockHeight);
     int nYesCount = 0;
 
     BOOST_FOREACH(CSuperblock_sptr pSuperblock, vecTriggers) {
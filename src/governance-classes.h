@@ -34,6 +34,7 @@ std::vector<std::string> SplitBy(std::string strCommand, std::string strDelimit)
 *   Trigger Mananger
 *
 *   - Track governance objects which are triggers
+*   - Index them by the height of their superblock
 *   - After triggers are activated and executed, they can be removed
 */
 
@@ -46,15 +47,20 @@ private:
     typedef std::map<uint256, CSuperblock_sptr> trigger_m_t;
     typedef trigger_m_t::iterator trigger_m_it;
     typedef trigger_m_t::const_iterator trigger_m_cit;
+    typedef std::map<int, std::set<uint256> > height_trigger_m_t;
+    typedef height_trigger_m_t::iterator height_trigger_m_it;
 
     trigger_m_t mapTrigger;
 
-    std::vector<CSuperblock_sptr> GetActiveTriggers();
+    // hashes of the triggers by the height of their superblock
+    height_trigger_m_t mapTriggerHeights;
+
+    std::vector<CSuperblock_sptr> GetActiveTriggers(int nBlockHeight);
     bool AddNewTrigger(uint256 nHash);
     void CleanAndRemove();
 
 public:
-    CGovernanceTriggerManager() : mapTrigger() {}
+    CGovernanceTriggerManager() : mapTrigger(), mapTriggerHeights() {}
 };
 
 /**
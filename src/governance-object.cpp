@@ -35,6 +35,7 @@ CGovernanceObject::CGovernanceObject()
   fExpired(false),
   fUnparsable(false),
   mapCurrentMNVotes(),
+  mapVoteCounts(),
   mapOrphanVotes(),
   fileVotes()
 {
@@ -63,6 +64,7 @@ CGovernanceObject::CGovernanceObject(uint256 nHashParentIn, int nRevisionIn, int
   fExpired(false),
   fUnparsable(false),
   mapCurrentMNVotes(),
+  mapVoteCounts(),
   mapOrphanVotes(),
   fileVotes()
 {
@@ -91,6 +93,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other)
   fExpired(other.fExpired),
   fUnparsable(other.fUnparsable),
   mapCurrentMNVotes(other.mapCurrentMNVotes),
+  mapVoteCounts(other.mapVoteCounts),
   mapOrphanVotes(other.mapOrphanVotes),
   fileVotes(other.fileVotes)
 {}
@@ -139,6 +142,7 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     vote_instance_m_it it2 = recVote.mapInstances.find(int(eSignal));
     if(it2 == recVote.mapInstances.end()) {
         it2 = recVote.mapInstances.insert(vote_instance_m_t::value_type(int(eSignal), vote_instance_t())).first;
+        ++mapVoteCounts[std::make_pair(int(eSignal), int(VOTE_OUTCOME_NONE))];
     }
     vote_instance_t& voteInstance = it2->second;
 
@@ -188,6 +192,8 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_PERMANENT_ERROR);
         return false;
     }
+    --mapVoteCounts[std::make_pair(int(eSignal), int(voteInstance.eOutcome))];
+    ++mapVoteCounts[std::make_pair(int(eSignal), int(vote.GetOutcome()))];
     voteInstance = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     if(!fileVotes.HasVote(vote.GetHash())) {
         fileVotes.AddVote(vote);
@@ -209,6 +215,7 @@ void CGovernanceObject::RebuildVoteMap()
         }
     }
     mapCurrentMNVotes = mapMNVotesNew;
+    RecalculateVoteCounts();
 }
 
 void CGovernanceObject::ClearMasternodeVotes()
@@ -228,6 +235,7 @@ void CGovernanceObject::ClearMasternodeVotes()
         }
 
         if(fRemove) {
+            UpdateVoteCounts(it->second, -1);
             mapCurrentMNVotes.erase(it++);
         }
         else {
@@ -603,21 +611,25 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError)
     return true;
 }
 
-int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const
+void CGovernanceObject::UpdateVoteCounts(const vote_rec_t& recVote, int nDelta)
+{
+    for(vote_instance_m_cit it = recVote.mapInstances.begin(); it != recVote.mapInstances.end(); ++it) {
+        mapVoteCounts[std::make_pair(it->first, int(it->second.eOutcome))] += nDelta;
+    }
+}
+
+void CGovernanceObject::RecalculateVoteCounts()
 {
-    int nCount = 0;
+    mapVoteCounts.clear();
     for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
-        const vote_rec_t& recVote = it->second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if(it2 == recVote.mapInstances.end()) {
-            continue;
-        }
-        const vote_instance_t& voteInstance = it2->second;
-        if(voteInstance.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
-        }
+        UpdateVoteCounts(it->second, 1);
     }
-    return nCount;
+}
+
+int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const
+{
+    vote_count_m_cit it = mapVoteCounts.find(std::make_pair(int(eVoteSignalIn), int(eVoteOutcomeIn)));
+    return it == mapVoteCounts.end() ? 0 : it->second;
 }
 
 /**
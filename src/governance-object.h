@@ -26,9 +26,15 @@ class CGovernanceVote;
 static const int MAX_GOVERNANCE_OBJECT_DATA_SIZE = 16 * 1024;
 static const int MIN_GOVERNANCE_PEER_PROTO_VERSION = 70206;
 static const int GOVERNANCE_FILTER_PROTO_VERSION = 70206;
+static const int GOVERNANCE_VOTE_SKETCH_PROTO_VERSION = 70208;
 
 static const double GOVERNANCE_FILTER_FP_RATE = 0.001;
 
+// vote set reconciliation, the sketch has one cell per GOVERNANCE_VOTE_SKETCH_VOTES_PER_CELL votes we know
+static const unsigned int GOVERNANCE_VOTE_SKETCH_MIN_CELLS = 96;
+static const unsigned int GOVERNANCE_VOTE_SKETCH_VOTES_PER_CELL = 16;
+static const int64_t GOVERNANCE_VOTE_SKETCH_TIMEOUT = 60;
+
 static const int GOVERNANCE_OBJECT_UNKNOWN = 0;
 static const int GOVERNANCE_OBJECT_PROPOSAL = 1;
 static const int GOVERNANCE_OBJECT_TRIGGER = 2;
@@ -123,6 +129,11 @@ public: // Types
 
     typedef CacheMultiMap<CTxIn, vote_time_pair_t> vote_mcache_t;
 
+    /// Number of vote instances in mapCurrentMNVotes by signal and outcome
+    typedef std::map<std::pair<int, int>, int> vote_count_m_t;
+
+    typedef vote_count_m_t::const_iterator vote_count_m_cit;
+
 private:
     /// critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -183,6 +194,9 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    /// Tallies of mapCurrentMNVotes, kept up to date whenever it changes
+    vote_count_m_t mapVoteCounts;
+
     /// Limited map of votes orphaned by MN
     vote_mcache_t mapOrphanVotes;
 
@@ -323,6 +337,9 @@ public:
             READWRITE(fExpired);
             READWRITE(mapCurrentMNVotes);
             READWRITE(fileVotes);
+            if(ser_action.ForRead()) {
+                RecalculateVoteCounts();
+            }
             LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
 
@@ -349,6 +366,10 @@ private:
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
+    /// Add nDelta to the tallies of every vote instance of recVote
+    void UpdateVoteCounts(const vote_rec_t& recVote, int nDelta);
+    void RecalculateVoteCounts();
+
     void CheckOrphanVotes();
 
 };
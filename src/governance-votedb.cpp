@@ -4,15 +4,124 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "governance-votedb.h"
+#include "util.h"
+
+#include <boost/scoped_ptr.hpp>
+
+static const char DB_GOVERNANCE_VOTE = 'v';
+static const char DB_GOVERNANCE_VOTE_PARENT = 'p';
+
+CGovernanceVoteDB* pgovernancevotedb = NULL;
+
+CGovernanceVoteDB::CGovernanceVoteDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CDBWrapper(GetDataDir() / "govvotes", nCacheSize, fMemory, fWipe)
+{}
+
+bool CGovernanceVoteDB::WriteVotes(const std::vector<CGovernanceVote>& vecVotes)
+{
+    CDBBatch batch(&GetObfuscateKey());
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        batch.Write(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(vecVotes[i].GetParentHash(), vecVotes[i].GetHash())), vecVotes[i]);
+        batch.Write(std::make_pair(DB_GOVERNANCE_VOTE_PARENT, vecVotes[i].GetHash()), vecVotes[i].GetParentHash());
+    }
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::HasVote(const uint256& nParentHash, const uint256& nHash) const
+{
+    return Exists(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nHash)));
+}
+
+bool CGovernanceVoteDB::ReadVote(const uint256& nParentHash, const uint256& nHash, CGovernanceVote& vote) const
+{
+    return Read(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nHash)), vote);
+}
+
+bool CGovernanceVoteDB::ReadVoteParent(const uint256& nHash, uint256& nParentHashRet) const
+{
+    return Read(std::make_pair(DB_GOVERNANCE_VOTE_PARENT, nHash), nParentHashRet);
+}
+
+bool CGovernanceVoteDB::ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotesRet)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, uint256())));
+
+    while(pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if(!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_VOTE || key.second.first != nParentHash) {
+            break;
+        }
+        CGovernanceVote vote;
+        if(!pcursor->GetValue(vote)) {
+            return error("CGovernanceVoteDB::ReadVotes -- unable to read vote %s", key.second.second.ToString());
+        }
+        vecVotesRet.push_back(vote);
+        pcursor->Next();
+    }
+
+    return true;
+}
+
+bool CGovernanceVoteDB::EraseVotes(const uint256& nParentHash, const std::vector<uint256>& vecHashes)
+{
+    CDBBatch batch(&GetObfuscateKey());
+    for(size_t i = 0; i < vecHashes.size(); ++i) {
+        batch.Erase(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, vecHashes[i])));
+        batch.Erase(std::make_pair(DB_GOVERNANCE_VOTE_PARENT, vecHashes[i]));
+    }
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::EraseObjectVotes(const uint256& nParentHash)
+{
+    std::vector<CGovernanceVote> vecVotes;
+    if(!ReadVotes(nParentHash, vecVotes)) {
+        return false;
+    }
+    std::vector<uint256> vecHashes;
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        vecHashes.push_back(vecVotes[i].GetHash());
+    }
+    return EraseVotes(nParentHash, vecHashes);
+}
+
+bool CGovernanceVoteDB::ReadObjectHashes(std::set<uint256>& setHashesRet)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // jump from object to object instead of going through all the votes
+    uint256 nLastVoteHash;
+    nLastVoteHash.SetHex("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    pcursor->Seek(DB_GOVERNANCE_VOTE);
+
+    while(pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if(!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_VOTE) {
+            break;
+        }
+        std::pair<char, std::pair<uint256, uint256> > keyLast = std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(key.second.first, nLastVoteHash));
+        setHashesRet.insert(key.second.first);
+        pcursor->Seek(keyLast);
+        if(pcursor->Valid() && pcursor->GetKey(key) && key == keyLast) {
+            pcursor->Next();
+        }
+    }
+
+    return true;
+}
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
-    : nMemoryVotes(0),
+    : nParentHash(),
+      nVoteCount(0),
       listVotes(),
       mapVoteIndex()
 {}
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other)
-    : nMemoryVotes(other.nMemoryVotes),
+    : nParentHash(other.nParentHash),
+      nVoteCount(other.nVoteCount),
       listVotes(other.listVotes),
       mapVoteIndex()
 {
@@ -21,13 +130,21 @@ CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVote
 
 void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
 {
+    nParentHash = vote.GetParentHash();
+    ++nVoteCount;
+    if(pgovernancevotedb) {
+        pgovernancevotedb->WriteVotes(std::vector<CGovernanceVote>(1, vote));
+        return;
+    }
     listVotes.push_front(vote);
     mapVoteIndex[vote.GetHash()] = listVotes.begin();
-    ++nMemoryVotes;
 }
 
 bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
 {
+    if(pgovernancevotedb) {
+        return nVoteCount > 0 && pgovernancevotedb->HasVote(nParentHash, nHash);
+    }
     vote_m_cit it = mapVoteIndex.find(nHash);
     if(it == mapVoteIndex.end()) {
         return false;
@@ -37,6 +154,9 @@ bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
 
 bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& vote) const
 {
+    if(pgovernancevotedb) {
+        return nVoteCount > 0 && pgovernancevotedb->ReadVote(nParentHash, nHash, vote);
+    }
     vote_m_cit it = mapVoteIndex.find(nHash);
     if(it == mapVoteIndex.end()) {
         return false;
@@ -48,6 +168,12 @@ bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& v
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 {
     std::vector<CGovernanceVote> vecResult;
+    if(pgovernancevotedb) {
+        if(nVoteCount > 0) {
+            pgovernancevotedb->ReadVotes(nParentHash, vecResult);
+        }
+        return vecResult;
+    }
     for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
         vecResult.push_back(*it);
     }
@@ -56,10 +182,24 @@ std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const CTxIn& vinMasternode)
 {
+    if(pgovernancevotedb) {
+        std::vector<uint256> vecHashes;
+        std::vector<CGovernanceVote> vecVotes = GetVotes();
+        for(size_t i = 0; i < vecVotes.size(); ++i) {
+            if(vecVotes[i].GetVinMasternode() == vinMasternode) {
+                vecHashes.push_back(vecVotes[i].GetHash());
+            }
+        }
+        if(!vecHashes.empty()) {
+            pgovernancevotedb->EraseVotes(nParentHash, vecHashes);
+            nVoteCount = std::max(0, nVoteCount - (int)vecHashes.size());
+        }
+        return;
+    }
     vote_l_it it = listVotes.begin();
     while(it != listVotes.end()) {
         if(it->GetVinMasternode() == vinMasternode) {
-            --nMemoryVotes;
+            --nVoteCount;
             mapVoteIndex.erase(it->GetHash());
             listVotes.erase(it++);
         }
@@ -69,9 +209,20 @@ void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const CTxIn& vinMaster
     }
 }
 
+void CGovernanceObjectVoteFile::RemoveAllVotes()
+{
+    if(pgovernancevotedb && nVoteCount > 0) {
+        pgovernancevotedb->EraseObjectVotes(nParentHash);
+    }
+    nVoteCount = 0;
+    listVotes.clear();
+    mapVoteIndex.clear();
+}
+
 CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
 {
-    nMemoryVotes = other.nMemoryVotes;
+    nParentHash = other.nParentHash;
+    nVoteCount = other.nVoteCount;
     listVotes = other.listVotes;
     RebuildIndex();
     return *this;
@@ -80,18 +231,29 @@ CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanc
 void CGovernanceObjectVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
-    nMemoryVotes = 0;
+    if(pgovernancevotedb && listVotes.empty()) {
+        // the votes are in the vote store
+        return;
+    }
+    nVoteCount = 0;
     vote_l_it it = listVotes.begin();
     while(it != listVotes.end()) {
         CGovernanceVote& vote = *it;
         uint256 nHash = vote.GetHash();
         if(mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
             mapVoteIndex[nHash] = it;
-            ++nMemoryVotes;
+            ++nVoteCount;
             ++it;
         }
         else {
             listVotes.erase(it++);
         }
     }
+    if(pgovernancevotedb) {
+        // votes kept in memory before there was a vote store, move them there
+        nParentHash = listVotes.front().GetParentHash();
+        pgovernancevotedb->WriteVotes(std::vector<CGovernanceVote>(listVotes.begin(), listVotes.end()));
+        listVotes.clear();
+        mapVoteIndex.clear();
+    }
 }
@@ -7,18 +7,53 @@
 
 #include <list>
 #include <map>
+#include <set>
 
+#include "dbwrapper.h"
 #include "governance-vote.h"
 #include "serialize.h"
 #include "uint256.h"
 
+class CGovernanceVoteDB;
+
+extern CGovernanceVoteDB* pgovernancevotedb;
+
+/** Cache size of the vote store in MiB */
+static const int64_t GOVERNANCE_VOTE_DB_CACHE = 8;
+
+/**
+ * Persistent store of the votes of all governance objects, keyed by object hash and vote hash,
+ * so the votes of an object can be read without reading everything else.
+ * The object of each vote is indexed by vote hash too, so a vote can be found from its hash alone.
+ */
+class CGovernanceVoteDB : public CDBWrapper
+{
+public:
+    CGovernanceVoteDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CGovernanceVoteDB(const CGovernanceVoteDB&);
+    void operator=(const CGovernanceVoteDB&);
+
+public:
+    bool WriteVotes(const std::vector<CGovernanceVote>& vecVotes);
+    bool HasVote(const uint256& nParentHash, const uint256& nHash) const;
+    bool ReadVote(const uint256& nParentHash, const uint256& nHash, CGovernanceVote& vote) const;
+    /// Look up the object a vote belongs to
+    bool ReadVoteParent(const uint256& nHash, uint256& nParentHashRet) const;
+    bool ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotesRet);
+    bool EraseVotes(const uint256& nParentHash, const std::vector<uint256>& vecHashes);
+    bool EraseObjectVotes(const uint256& nParentHash);
+
+    /// Hashes of all objects which have votes in the store
+    bool ReadObjectHashes(std::set<uint256>& setHashesRet);
+};
+
 /**
  * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * The votes live in pgovernancevotedb and are read from it on demand, only their number
+ * is kept in memory. Without a vote store (e.g. in unit tests) they are kept in memory.
  */
 class CGovernanceObjectVoteFile
 {
@@ -36,10 +71,12 @@ public: // Types
     typedef vote_m_t::const_iterator vote_m_cit;
 
 private:
-    static const int MAX_MEMORY_VOTES = -1;
+    /// Hash of the object the votes belong to, set by the first vote
+    uint256 nParentHash;
 
-    int nMemoryVotes;
+    int nVoteCount;
 
+    /// Only used without a vote store
     vote_l_t listVotes;
 
     vote_m_t mapVoteIndex;
@@ -55,17 +92,17 @@ public:
     void AddVote(const CGovernanceVote& vote);
 
     /**
-     * Return true if the vote with this hash is currently cached in memory
+     * Return true if the file has a vote with this hash
      */
     bool HasVote(const uint256& nHash) const;
 
     /**
-     * Retrieve a vote cached in memory
+     * Retrieve a vote, from disk when there's a vote store
      */
     bool GetVote(const uint256& nHash, CGovernanceVote& vote) const;
 
     int GetVoteCount() {
-        return nMemoryVotes;
+        return nVoteCount;
     }
 
     std::vector<CGovernanceVote> GetVotes() const;
@@ -74,12 +111,18 @@ public:
 
     void RemoveVotesFromMasternode(const CTxIn& vinMasternode);
 
+    /**
+     * Remove all votes of the object from the vote store, called when the object is deleted
+     */
+    void RemoveAllVotes();
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        READWRITE(nMemoryVotes);
+        READWRITE(nParentHash);
+        READWRITE(nVoteCount);
         READWRITE(listVotes);
         if(ser_action.ForRead()) {
             RebuildIndex();
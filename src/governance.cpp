@@ -18,7 +18,7 @@ CGovernanceManager governance;
 
 int nSubmittedFinalBudget;
 
-const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-11";
+const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-13";
 
 CGovernanceManager::CGovernanceManager()
     : pCurrentBlockIndex(NULL),
@@ -36,6 +36,7 @@ CGovernanceManager::CGovernanceManager()
       mapLastMasternodeObject(),
       setRequestedObjects(),
       fRateChecksEnabled(true),
+      fStaleVotesRemoved(false),
       cs()
 {}
 
@@ -60,8 +61,8 @@ bool CGovernanceManager::HaveVoteForHash(uint256 nHash)
 {
     LOCK(cs);
 
-    CGovernanceObject* pGovobj = NULL;
-    if(!mapVoteToObject.Get(nHash,pGovobj)) {
+    CGovernanceObject* pGovobj = FindVoteObject(nHash);
+    if(!pGovobj) {
         return false;
     }
 
@@ -81,8 +82,8 @@ bool CGovernanceManager::SerializeVoteForHash(uint256 nHash, CDataStream& ss)
 {
     LOCK(cs);
 
-    CGovernanceObject* pGovobj = NULL;
-    if(!mapVoteToObject.Get(nHash,pGovobj)) {
+    CGovernanceObject* pGovobj = FindVoteObject(nHash);
+    if(!pGovobj) {
         return false;
     }
 
@@ -99,6 +100,7 @@ void CGovernanceManager::AddSeenGovernanceObject(uint256 nHash, int status)
 {
     LOCK(cs);
     mapSeenGovernanceObjects[nHash] = status;
+    cacheGeneration.Bump();
 }
 
 void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
@@ -146,6 +148,42 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
     }
 
+    // A PEER IS ASKING FOR THE VOTES IT IS MISSING, OR TELLS US IT COULD NOT RECONCILE OUR SKETCH
+    else if (strCommand == NetMsgType::MNGOVERNANCEVOTESKETCH)
+    {
+        uint256 nProp;
+        CInvertibleBloomLookupTable sketch;
+
+        vRecv >> nProp >> sketch;
+
+        if(sketch.size() == 0) {
+            // the difference was too big for the sketch we sent, ask again with a bloom filter
+            {
+                LOCK(cs);
+                sketch_request_m_it it = mapVoteSketchRequests.find(std::make_pair(nProp, pfrom->id));
+                if(it == mapVoteSketchRequests.end()) {
+                    LogPrint("gobject", "MNGOVERNANCEVOTESKETCH -- unrequested reply for %s, peer=%d\n", nProp.ToString(), pfrom->id);
+                    return;
+                }
+                mapVoteSketchRequests.erase(it);
+            }
+            LogPrint("gobject", "MNGOVERNANCEVOTESKETCH -- peer=%d could not decode our sketch for %s, falling back to filter\n", pfrom->id, nProp.ToString());
+            RequestGovernanceObject(pfrom, nProp, true);
+            return;
+        }
+
+        // Ignore such requests until we are fully synced, same as MNGOVERNANCESYNC
+        if (!masternodeSync.IsSynced()) return;
+
+        if(nProp == uint256() || !sketch.IsWithinSizeConstraints()) {
+            LogPrintf("MNGOVERNANCEVOTESKETCH -- invalid sketch of %d cells, peer=%d\n", sketch.size(), pfrom->id);
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        SyncVoteSketch(pfrom, nProp, sketch);
+    }
+
     // A NEW GOVERNANCE OBJECT HAS ARRIVED
     else if (strCommand == NetMsgType::MNGOVERNANCEOBJECT)
 
@@ -184,6 +222,8 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             LogPrint("gobject", "MNGOVERNANCEOBJECT -- Received already seen object: %s\n", strHash);
             return;
         }
+        // from here on the object is added to the seen or the rate check buffers at least
+        cacheGeneration.Bump();
 
         bool fRateCheckBypassed = false;
         if(!MasternodeRateCheck(govobj, UPDATE_FAIL_ONLY, false, fRateCheckBypassed)) {
@@ -308,6 +348,9 @@ void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernance
             mapOrphanVotes.Erase(nHash, pairVote);
         }
     }
+    if(!vecVotePairs.empty()) {
+        cacheGeneration.Bump();
+    }
     fRateChecksEnabled = true;
 }
 
@@ -359,8 +402,14 @@ bool CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, bool& fA
         }
     }
 
+    // votes a previous run stored for this object are left over from dropping it, they must not count as ones we have
+    if(pgovernancevotedb && govobj.GetVoteFile().GetVoteCount() == 0) {
+        pgovernancevotedb->EraseObjectVotes(nHash);
+    }
+
     // INSERT INTO OUR GOVERNANCE OBJECT MEMORY
     mapObjects.insert(std::make_pair(nHash, govobj));
+    cacheGeneration.Bump();
 
     // SHOULD WE ADD THIS OBJECT TO ANY OTHER MANANGERS?
 
@@ -414,6 +463,7 @@ bool CGovernanceManager::UpdateCurrentWatchdog(CGovernanceObject& watchdogNew)
         }
         nHashWatchdogCurrent = watchdogNew.GetHash();
         nTimeWatchdogCurrent = watchdogNew.GetCreationTime();
+        cacheGeneration.Bump();
         fAccept = true;
         LogPrint("gobject", "CGovernanceManager::UpdateCurrentWatchdog -- Current watchdog updated to: hash = %s\n",
                  ArithToUint256(nHashNew).ToString());
@@ -430,6 +480,9 @@ void CGovernanceManager::UpdateCachesAndClean()
 
     LOCK(cs);
 
+    // only bump the cache generation if an object or a watchdog actually changed
+    bool fCacheChanged = false;
+
     // Flag expired watchdogs for removal
     int64_t nNow = GetAdjustedTime();
     LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Number watchdogs in map: %d, current time = %d\n", mapWatchdogObjects.size(), nNow);
@@ -451,6 +504,7 @@ void CGovernanceManager::UpdateCachesAndClean()
                     nHashWatchdogCurrent = uint256();
                 }
                 mapWatchdogObjects.erase(it++);
+                fCacheChanged = true;
             }
             else {
                 ++it;
@@ -458,6 +512,15 @@ void CGovernanceManager::UpdateCachesAndClean()
         }
     }
 
+    sketch_request_m_it itSketch = mapVoteSketchRequests.begin();
+    while(itSketch != mapVoteSketchRequests.end()) {
+        if(itSketch->second < GetTime()) {
+            mapVoteSketchRequests.erase(itSketch++);
+        } else {
+            ++itSketch;
+        }
+    }
+
     for(size_t i = 0; i < vecDirtyHashes.size(); ++i) {
         object_m_it it = mapObjects.find(vecDirtyHashes[i]);
         if(it == mapObjects.end()) {
@@ -465,6 +528,11 @@ void CGovernanceManager::UpdateCachesAndClean()
         }
         it->second.ClearMasternodeVotes();
         it->second.fDirtyCache = true;
+        fCacheChanged = true;
+    }
+
+    if(fCacheChanged) {
+        cacheGeneration.Bump();
     }
 
     // DOUBLE CHECK THAT WE HAVE A VALID POINTER TO TIP
@@ -501,10 +569,12 @@ void CGovernanceManager::UpdateCachesAndClean()
 
             // UPDATE SENTINEL SIGNALING VARIABLES
             pObj->UpdateSentinelVariables();
+            cacheGeneration.Bump();
         }
 
         if(pObj->IsSetCachedDelete() && (nHash == nHashWatchdogCurrent)) {
             nHashWatchdogCurrent = uint256();
+            cacheGeneration.Bump();
         }
 
         // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
@@ -535,7 +605,9 @@ void CGovernanceManager::UpdateCachesAndClean()
             if(pObj->nObjectType == GOVERNANCE_OBJECT_WATCHDOG) {
                 mapWatchdogObjects.erase(it->first);
             }
+            pObj->GetVoteFile().RemoveAllVotes();
             mapObjects.erase(it++);
+            cacheGeneration.Bump();
         } else {
             ++it;
         }
@@ -581,8 +653,8 @@ std::vector<CGovernanceVote> CGovernanceManager::GetCurrentVotes(const uint256&
     // Compile a list of Masternode collateral outpoints for which to get votes
     std::vector<CTxIn> vecMNTxIn;
     if (mnCollateralOutpointFilter == CTxIn()) {
-        std::vector<CMasternode> mnlist = mnodeman.GetFullMasternodeVector();
-        for (std::vector<CMasternode>::iterator it = mnlist.begin(); it != mnlist.end(); ++it)
+        CMasternodeMan::list_snapshot_t pMasternodes = mnodeman.GetListSnapshot();
+        for (std::vector<CMasternode>::const_iterator it = pMasternodes->begin(); it != pMasternodes->end(); ++it)
         {
             vecMNTxIn.push_back(it->vin);
         }
@@ -673,6 +745,8 @@ void CGovernanceManager::DoMaintenance()
 
     RequestOrphanObjects();
 
+    RemoveStaleVotes();
+
     // CHECK AND REMOVE - REPROCESS GOVERNANCE OBJECTS
 
     UpdateCachesAndClean();
@@ -697,7 +771,7 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
     break;
     case MSG_GOVERNANCE_OBJECT_VOTE:
     {
-        if(mapVoteToObject.HasKey(inv.hash)) {
+        if(FindVoteObject(inv.hash)) {
             LogPrint("gobject", "CGovernanceManager::ConfirmInventoryRequest already have governance vote, returning false\n");
             return false;
         }
@@ -816,6 +890,74 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
     LogPrintf("CGovernanceManager::Sync -- sent %d objects and %d votes to peer=%d\n", nObjCount, nVoteCount, pfrom->id);
 }
 
+void CGovernanceManager::SyncVoteSketch(CNode* pfrom, const uint256& nProp, const CInvertibleBloomLookupTable& sketch)
+{
+    // do not provide any data until our node is synced
+    if(fMasterNode && !masternodeSync.IsSynced()) return;
+
+    int nVoteCount = 0;
+    std::set<uint64_t> setOurs;
+    std::set<uint64_t> setTheirs;
+    bool fDecoded = false;
+
+    LogPrint("gobject", "CGovernanceManager::SyncVoteSketch -- syncing to peer=%d, nProp = %s, cells = %d\n", pfrom->id, nProp.ToString(), sketch.size());
+
+    {
+        LOCK2(cs_main, cs);
+
+        object_m_it it = mapObjects.find(nProp);
+        if(it == mapObjects.end()) {
+            LogPrint("gobject", "CGovernanceManager::SyncVoteSketch -- no matching object for hash %s, peer=%d\n", nProp.ToString(), pfrom->id);
+            return;
+        }
+        CGovernanceObject& govobj = it->second;
+
+        if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
+            LogPrintf("CGovernanceManager::SyncVoteSketch -- not syncing deleted/expired govobj: %s, peer=%d\n",
+                      nProp.ToString(), pfrom->id);
+            return;
+        }
+
+        // our valid votes go into a table like the peer's one, what's left after subtracting theirs is the difference
+        CInvertibleBloomLookupTable table(sketch.size(), sketch.GetSalt());
+        std::map<uint64_t, uint256> mapShortIds;
+        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+        for(size_t i = 0; i < vecVotes.size(); ++i) {
+            if(!vecVotes[i].IsValid(true)) {
+                continue;
+            }
+            uint256 nVoteHash = vecVotes[i].GetHash();
+            uint64_t nShortId = table.GetShortId(nVoteHash);
+            mapShortIds[nShortId] = nVoteHash;
+            table.insert(nShortId);
+        }
+
+        fDecoded = table.Subtract(sketch) && table.Decode(setOurs, setTheirs);
+
+        if(fDecoded) {
+            pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, nProp));
+            BOOST_FOREACH(uint64_t nShortId, setOurs) {
+                std::map<uint64_t, uint256>::iterator it2 = mapShortIds.find(nShortId);
+                // not one of ours, the peer's sketch was crafted
+                if(it2 == mapShortIds.end()) continue;
+                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, it2->second));
+                ++nVoteCount;
+            }
+        }
+    }
+
+    if(!fDecoded) {
+        // tell the peer to come back with a bloom filter
+        LogPrint("gobject", "CGovernanceManager::SyncVoteSketch -- could not decode sketch for %s, peer=%d\n", nProp.ToString(), pfrom->id);
+        pfrom->PushMessage(NetMsgType::MNGOVERNANCEVOTESKETCH, nProp, CInvertibleBloomLookupTable());
+        return;
+    }
+
+    pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, 1);
+    pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount);
+    LogPrintf("CGovernanceManager::SyncVoteSketch -- sent %d votes to peer=%d, peer has %d votes we don't\n", nVoteCount, pfrom->id, setTheirs.size());
+}
+
 bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, update_mode_enum_t eUpdateLast)
 {
     bool fRateCheckBypassed = false;
@@ -862,6 +1004,7 @@ bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, up
             default:
                 break;
             }
+            cacheGeneration.Bump();
         }
         return true;
     }
@@ -919,11 +1062,13 @@ bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, up
     case UPDATE_TRUE:
         pBuffer->AddTimestamp(nTimestamp);
         it->second.fStatusOK = fRateOK;
+        cacheGeneration.Bump();
         break;
     case UPDATE_FAIL_ONLY:
         if(!fRateOK) {
             pBuffer->AddTimestamp(nTimestamp);
             it->second.fStatusOK = false;
+            cacheGeneration.Bump();
         }
     default:
         return true;
@@ -962,6 +1107,7 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
              << ", governance object hash = " << vote.GetParentHash().ToString() << "\n";
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_WARNING);
         if(mapOrphanVotes.Insert(nHashGovobj, vote_time_pair_t(vote, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME))) {
+            cacheGeneration.Bump();
             RequestGovernanceObject(pfrom, nHashGovobj);
             LogPrintf(ostr.str().c_str());
         }
@@ -981,6 +1127,7 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
     bool fOk = govobj.ProcessVote(pfrom, vote, exception);
     if(fOk) {
         mapVoteToObject.Insert(nHashVote, &govobj);
+        cacheGeneration.Bump();
 
         if(govobj.GetObjectType() == GOVERNANCE_OBJECT_WATCHDOG) {
             mnodeman.UpdateWatchdogVoteTime(vote.GetVinMasternode());
@@ -996,6 +1143,8 @@ void CGovernanceManager::CheckMasternodeOrphanVotes()
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         it->second.CheckOrphanVotes();
     }
+    // votes of the newly known masternodes might have been added to the objects
+    cacheGeneration.Bump();
     fRateChecksEnabled = true;
 }
 
@@ -1072,6 +1221,42 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
     pfrom->PushMessage(NetMsgType::MNGOVERNANCESYNC, nHash, filter);
 }
 
+bool CGovernanceManager::RequestGovernanceObjectVoteSketch(CNode* pfrom, const uint256& nHash)
+{
+    if(!pfrom || pfrom->nVersion < GOVERNANCE_VOTE_SKETCH_PROTO_VERSION) {
+        return false;
+    }
+
+    CInvertibleBloomLookupTable sketch;
+
+    {
+        LOCK(cs);
+        CGovernanceObject* pObj = FindGovernanceObject(nHash);
+        if(!pObj) {
+            return false;
+        }
+
+        std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
+        // nothing to reconcile, everything the peer has is missing
+        if(vecVotes.empty()) {
+            return false;
+        }
+
+        unsigned int nCells = std::max<unsigned int>(GOVERNANCE_VOTE_SKETCH_MIN_CELLS, vecVotes.size() / GOVERNANCE_VOTE_SKETCH_VOTES_PER_CELL);
+        sketch = CInvertibleBloomLookupTable(std::min(nCells, MAX_IBLT_CELLS), GetRand(std::numeric_limits<uint64_t>::max()));
+        for(size_t i = 0; i < vecVotes.size(); ++i) {
+            sketch.insert(vecVotes[i].GetHash());
+        }
+
+        mapVoteSketchRequests[std::make_pair(nHash, pfrom->id)] = GetTime() + GOVERNANCE_VOTE_SKETCH_TIMEOUT;
+    }
+
+    LogPrint("gobject", "CGovernanceObject::RequestGovernanceObjectVoteSketch -- hash = %s, cells = %d (peer=%d)\n", nHash.ToString(), sketch.size(), pfrom->GetId());
+
+    pfrom->PushMessage(NetMsgType::MNGOVERNANCEVOTESKETCH, nHash, sketch);
+    return true;
+}
+
 int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode)
 {
     if(pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) return -3;
@@ -1162,7 +1347,9 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
             // to early to ask the same node
             if(mapAskedRecently[nHashGovobj].count(pnode->addr)) continue;
 
-            RequestGovernanceObject(pnode, nHashGovobj, true);
+            if(!RequestGovernanceObjectVoteSketch(pnode, nHashGovobj)) {
+                RequestGovernanceObject(pnode, nHashGovobj, true);
+            }
             mapAskedRecently[nHashGovobj][pnode->addr] = nNow + nTimeout;
             fAsked = true;
             // stop loop if max number of peers per obj was asked
@@ -1209,6 +1396,8 @@ bool CGovernanceManager::AcceptMessage(const uint256& nHash, hash_s_t& setHash)
 void CGovernanceManager::RebuildIndexes()
 {
     mapVoteToObject.Clear();
+    // don't read every vote from disk, FindVoteObject() indexes them as they are asked for
+    if(pgovernancevotedb) return;
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         CGovernanceObject& govobj = it->second;
         std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
@@ -1218,6 +1407,27 @@ void CGovernanceManager::RebuildIndexes()
     }
 }
 
+CGovernanceObject* CGovernanceManager::FindVoteObject(const uint256& nHash)
+{
+    AssertLockHeld(cs);
+
+    CGovernanceObject* pGovobj = NULL;
+    if(mapVoteToObject.Get(nHash, pGovobj)) {
+        return pGovobj;
+    }
+
+    uint256 nParentHash;
+    if(!pgovernancevotedb || !pgovernancevotedb->ReadVoteParent(nHash, nParentHash)) {
+        return NULL;
+    }
+    object_m_it it = mapObjects.find(nParentHash);
+    if(it == mapObjects.end()) {
+        return NULL;
+    }
+    mapVoteToObject.Insert(nHash, &it->second);
+    return &it->second;
+}
+
 int CGovernanceManager::GetMasternodeIndex(const CTxIn& masternodeVin)
 {
     LOCK(cs);
@@ -1239,6 +1449,7 @@ void CGovernanceManager::RebuildVoteMaps()
         it->second.RebuildVoteMap();
     }
     mnodeman.ClearOldMasternodeIndex();
+    cacheGeneration.Bump();
 }
 
 void CGovernanceManager::AddCachedTriggers()
@@ -1267,6 +1478,44 @@ void CGovernanceManager::InitOnLoad()
     LogPrintf("     %s\n", ToString());
 }
 
+void CGovernanceManager::RemoveStaleVotes()
+{
+    if(!pgovernancevotedb) return;
+
+    {
+        LOCK(cs);
+        if(fStaleVotesRemoved) return;
+        fStaleVotesRemoved = true;
+    }
+
+    // votes of objects which were deleted while the cache wasn't written or which were dropped with the cache,
+    // the store is gone through without holding cs and only the objects still unknown afterwards are erased
+    std::set<uint256> setHashes;
+    pgovernancevotedb->ReadObjectHashes(setHashes);
+
+    LOCK(cs);
+    int nRemoved = 0;
+    BOOST_FOREACH(const uint256& nHash, setHashes) {
+        if(mapObjects.count(nHash)) continue;
+        pgovernancevotedb->EraseObjectVotes(nHash);
+        ++nRemoved;
+    }
+    LogPrintf("Governance vote store has votes for %d objects, removed %d stale ones\n", setHashes.size(), nRemoved);
+}
+
+void CGovernanceManager::GetCacheSnapshot(cache_snapshot_t& snapshotRet) const
+{
+    LOCK(cs);
+    snapshotRet.mapSeenGovernanceObjects = mapSeenGovernanceObjects;
+    snapshotRet.mapInvalidVotes = mapInvalidVotes;
+    snapshotRet.mapOrphanVotes = mapOrphanVotes;
+    snapshotRet.mapObjects = mapObjects;
+    snapshotRet.mapWatchdogObjects = mapWatchdogObjects;
+    snapshotRet.nHashWatchdogCurrent = nHashWatchdogCurrent;
+    snapshotRet.nTimeWatchdogCurrent = nTimeWatchdogCurrent;
+    snapshotRet.mapLastMasternodeObject = mapLastMasternodeObject;
+}
+
 std::string CGovernanceManager::ToString() const
 {
     LOCK(cs);
@@ -1367,6 +1616,7 @@ void CGovernanceManager::CleanOrphanObjects()
         const vote_time_pair_t& pairVote = prevIt->value;
         if(pairVote.second < nNow) {
             mapOrphanVotes.Erase(prevIt->key, prevIt->value);
+            cacheGeneration.Bump();
         }
     }
 }
@@ -11,9 +11,11 @@
 #include "cachemap.h"
 #include "cachemultimap.h"
 #include "chain.h"
+#include "flat-database.h"
 #include "governance-exceptions.h"
 #include "governance-object.h"
 #include "governance-vote.h"
+#include "iblt.h"
 #include "net.h"
 #include "sync.h"
 #include "timedata.h"
@@ -221,6 +223,10 @@ public: // Types
 
     typedef hash_time_m_t::const_iterator hash_time_m_cit;
 
+    typedef std::map<std::pair<uint256, NodeId>, int64_t> sketch_request_m_t;
+
+    typedef sketch_request_m_t::iterator sketch_request_m_it;
+
 private:
     static const int MAX_CACHE_SIZE = 1000000;
 
@@ -257,12 +263,58 @@ private:
 
     hash_s_t setRequestedVotes;
 
+    // vote sketches we sent, by object and peer, with their expiration time
+    sketch_request_m_t mapVoteSketchRequests;
+
     bool fRateChecksEnabled;
 
+    // whether the vote store was cleaned of the votes of objects we don't have since startup
+    bool fStaleVotesRemoved;
+
+    // bumped whenever the state written to governance.dat changes, see MarkCacheChanged()
+    CFlatDBGeneration cacheGeneration;
+
+    /// The sections of governance.dat, shared by loading them into the manager and writing them from a cache_snapshot_t
+    template <typename Stream, typename Operation, typename State>
+    static void SerializeCache(Stream& s, Operation ser_action, int nType, int nVersion, State& state, std::string& strVersion, bool& fDamaged) {
+        READWRITE(FLATDB_SECTION(strVersion));
+        // all of these refer to the objects, losing any of them drops the whole cache
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapSeenGovernanceObjects, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapInvalidVotes, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapOrphanVotes, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapObjects, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapWatchdogObjects, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.nHashWatchdogCurrent, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.nTimeWatchdogCurrent, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapLastMasternodeObject, fDamaged));
+    }
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    /// Copy of the state written to governance.dat, serialized without holding cs
+    struct cache_snapshot_t
+    {
+        count_m_t mapSeenGovernanceObjects;
+        vote_cache_t mapInvalidVotes;
+        vote_mcache_t mapOrphanVotes;
+        object_m_t mapObjects;
+        hash_time_m_t mapWatchdogObjects;
+        uint256 nHashWatchdogCurrent;
+        int64_t nTimeWatchdogCurrent;
+        txout_m_t mapLastMasternodeObject;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+            std::string strVersion = SERIALIZATION_VERSION_STRING;
+            bool fDamaged = false;
+            SerializeCache(s, ser_action, nType, nVersion, *this, strVersion, fDamaged);
+        }
+    };
+
     CGovernanceManager();
 
     virtual ~CGovernanceManager() {}
@@ -316,6 +368,7 @@ public:
         mapInvalidVotes.Clear();
         mapOrphanVotes.Clear();
         mapLastMasternodeObject.clear();
+        cacheGeneration.Bump();
     }
 
     std::string ToString() const;
@@ -324,29 +377,32 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        if(!ser_action.ForRead()) {
+            // write a copy, so cs is only held while it is taken
+            cache_snapshot_t snapshot;
+            GetCacheSnapshot(snapshot);
+            READWRITE(snapshot);
+            return;
+        }
+
         LOCK(cs);
         std::string strVersion;
-        if(ser_action.ForRead()) {
-            READWRITE(strVersion);
-        }
-        else {
-            strVersion = SERIALIZATION_VERSION_STRING;
-            READWRITE(strVersion);
-        }
-        READWRITE(mapSeenGovernanceObjects);
-        READWRITE(mapInvalidVotes);
-        READWRITE(mapOrphanVotes);
-        READWRITE(mapObjects);
-        READWRITE(mapWatchdogObjects);
-        READWRITE(nHashWatchdogCurrent);
-        READWRITE(nTimeWatchdogCurrent);
-        READWRITE(mapLastMasternodeObject);
-        if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
+        bool fDamaged = false;
+        SerializeCache(s, ser_action, nType, nVersion, *this, strVersion, fDamaged);
+        if(strVersion != SERIALIZATION_VERSION_STRING || fDamaged) {
             Clear();
             return;
         }
+        cacheGeneration.Bump();
     }
 
+    /// Copy the state written to governance.dat
+    void GetCacheSnapshot(cache_snapshot_t& snapshotRet) const;
+    /// Changes whenever the state written to governance.dat does, doesn't take cs
+    uint64_t GetCacheGeneration() const { return cacheGeneration.Get(); }
+    /// Call after changing anything written to governance.dat from outside the manager, e.g. an object's flags
+    void MarkCacheChanged() { cacheGeneration.Bump(); }
+
     void UpdatedBlockTip(const CBlockIndex *pindex);
     int64_t GetLastDiffTime() { return nTimeLastDiff; }
     void UpdateLastDiffTime(int64_t nTimeIn) { nTimeLastDiff = nTimeIn; }
@@ -397,14 +453,22 @@ public:
 private:
     void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, bool fUseFilter = false);
 
+    /// Ask for the votes of an object we have by sending a sketch of our votes, false if the peer should get a filter instead
+    bool RequestGovernanceObjectVoteSketch(CNode* pfrom, const uint256& nHash);
+
+    /// Push the votes of an object which are missing from the peer's sketch
+    void SyncVoteSketch(CNode* pfrom, const uint256& nProp, const CInvertibleBloomLookupTable& sketch);
+
     void AddInvalidVote(const CGovernanceVote& vote)
     {
         mapInvalidVotes.Insert(vote.GetHash(), vote);
+        cacheGeneration.Bump();
     }
 
     void AddOrphanVote(const CGovernanceVote& vote)
     {
         mapOrphanVotes.Insert(vote.GetHash(), vote_time_pair_t(vote, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME));
+        cacheGeneration.Bump();
     }
 
     bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception);
@@ -419,8 +483,12 @@ private:
 
     void CheckOrphanVotes(CGovernanceObject& govobj, CGovernanceException& exception);
 
+    /// Index the votes kept in memory, the ones in the vote store are looked up by FindVoteObject()
     void RebuildIndexes();
 
+    /// Find the object a vote we have belongs to, indexing it if it was only known to the vote store
+    CGovernanceObject* FindVoteObject(const uint256& nHash);
+
     /// Returns MN index, handling the case of index rebuilds
     int GetMasternodeIndex(const CTxIn& masternodeVin);
 
@@ -432,6 +500,9 @@ private:
 
     void RequestOrphanObjects();
 
+    /// Remove the votes of objects we don't have from the vote store, once after startup
+    void RemoveStaleVotes();
+
     void CleanOrphanObjects();
 
 };
@@ -304,7 +304,33 @@ public:
     CHashVerifier<Source>& operator>>(T& obj)
     {
         // Unserialize from this stream
-        ::Unserialize(*this, obj);
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Writes data to an underlying stream, while hashing the written data. */
+template<typename Sink>
+class CHashingWriter : public CHashWriter
+{
+private:
+    Sink* sink;
+
+public:
+    explicit CHashingWriter(Sink* sink_) : CHashWriter(sink_->GetType(), sink_->GetVersion()), sink(sink_) {}
+
+    CHashingWriter<Sink>& write(const char* pch, size_t nSize)
+    {
+        sink->write(pch, nSize);
+        CHashWriter::write(pch, nSize);
+        return (*this);
+    }
+
+    template<typename T>
+    CHashingWriter<Sink>& operator<<(const T& obj)
+    {
+        // Serialize to this stream
+        ::Serialize(*this, obj, nType, nVersion);
         return (*this);
     }
 };
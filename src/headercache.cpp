@@ -0,0 +1,118 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "headercache.h"
+#include "memusage.h"
+#include "serialize.h"
+#include "version.h"
+
+#include <boost/foreach.hpp>
+
+void CHeaderCache::SetTip(CBlockIndex* pindexNew)
+{
+    LOCK(cs);
+
+    // find the fork point with the cached chain, remembering the blocks to append
+    std::vector<CBlockIndex*> vConnect;
+    CBlockIndex* pindexFork = pindexNew;
+    while (pindexFork && !(pindexFork->nHeight < (int)vIndex.size() && vIndex[pindexFork->nHeight] == pindexFork)) {
+        vConnect.push_back(pindexFork);
+        pindexFork = pindexFork->pprev;
+    }
+
+    int nForkHeight = pindexFork ? pindexFork->nHeight : -1;
+    for (int nHeight = (int)vIndex.size() - 1; nHeight > nForkHeight; nHeight--) {
+        mapHeight.erase(vIndex[nHeight]->GetBlockHash());
+    }
+    vIndex.resize(nForkHeight + 1);
+    vchHeaders.resize((nForkHeight + 1) * HEADER_CACHE_ENTRY_SIZE);
+
+    for (std::vector<CBlockIndex*>::reverse_iterator it = vConnect.rbegin(); it != vConnect.rend(); ++it) {
+        CBlockIndex* pindex = *it;
+        // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << CBlock(pindex->GetBlockHeader());
+        assert(ss.size() == HEADER_CACHE_ENTRY_SIZE);
+        vchHeaders.insert(vchHeaders.end(), ss.begin(), ss.end());
+        vIndex.push_back(pindex);
+        mapHeight[pindex->GetBlockHash()] = pindex->nHeight;
+    }
+}
+
+void CHeaderCache::Clear()
+{
+    LOCK(cs);
+    vIndex.clear();
+    vchHeaders.clear();
+    mapHeight.clear();
+}
+
+int CHeaderCache::FindFork(const CBlockLocator& locator) const
+{
+    AssertLockHeld(cs);
+    BOOST_FOREACH(const uint256& hash, locator.vHave) {
+        boost::unordered_map<uint256, int, CHeaderHasher>::const_iterator it = mapHeight.find(hash);
+        if (it != mapHeight.end())
+            return it->second;
+    }
+    return 0;
+}
+
+int CHeaderCache::FindLast(int nStartHeight, const uint256& hashStop, int nLimit) const
+{
+    AssertLockHeld(cs);
+    int nLastHeight = std::min((int)vIndex.size() - 1, nStartHeight + nLimit - 1);
+    boost::unordered_map<uint256, int, CHeaderHasher>::const_iterator it = mapHeight.find(hashStop);
+    if (it != mapHeight.end() && it->second >= nStartHeight)
+        nLastHeight = std::min(nLastHeight, it->second);
+    return nLastHeight;
+}
+
+CBlockIndex* CHeaderCache::GetHeaders(const CBlockLocator& locator, const uint256& hashStop, int nLimit, CDataStream& ssRet) const
+{
+    LOCK(cs);
+    if (vIndex.empty() || nLimit <= 0) {
+        WriteCompactSize(ssRet, 0);
+        return NULL;
+    }
+
+    int nStartHeight = FindFork(locator) + 1;
+    int nLastHeight = FindLast(nStartHeight, hashStop, nLimit);
+    if (nLastHeight < nStartHeight) {
+        WriteCompactSize(ssRet, 0);
+        return NULL;
+    }
+
+    WriteCompactSize(ssRet, nLastHeight - nStartHeight + 1);
+    ssRet.write(&vchHeaders[nStartHeight * HEADER_CACHE_ENTRY_SIZE], (nLastHeight - nStartHeight + 1) * HEADER_CACHE_ENTRY_SIZE);
+    return vIndex[nLastHeight];
+}
+
+void CHeaderCache::GetBlocks(const CBlockLocator& locator, const uint256& hashStop, int nLimit, std::vector<CBlockIndex*>& vRet) const
+{
+    LOCK(cs);
+    if (vIndex.empty() || nLimit <= 0)
+        return;
+
+    int nStartHeight = FindFork(locator) + 1;
+    int nLastHeight = FindLast(nStartHeight, hashStop, nLimit);
+    for (int nHeight = nStartHeight; nHeight <= nLastHeight; nHeight++) {
+        // unlike getheaders, getblocks doesn't announce the stop block itself
+        if (vIndex[nHeight]->GetBlockHash() == hashStop)
+            break;
+        vRet.push_back(vIndex[nHeight]);
+    }
+}
+
+int CHeaderCache::Height() const
+{
+    LOCK(cs);
+    return (int)vIndex.size() - 1;
+}
+
+size_t CHeaderCache::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return memusage::DynamicUsage(vIndex) + memusage::DynamicUsage(vchHeaders) + memusage::DynamicUsage(mapHeight);
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef HEADERCACHE_H
+#define HEADERCACHE_H
+
+#include "chain.h"
+#include "streams.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+/** Size of one header as sent in a headers message: the block header followed by an empty tx count */
+static const size_t HEADER_CACHE_ENTRY_SIZE = 81;
+
+/**
+ * Pre-serialized headers of the active chain, stored contiguously by height.
+ * It follows chainActive on every tip change (see UpdateTip) and has its own lock,
+ * so getheaders and getblocks can be answered by slicing this array without holding
+ * cs_main and without building and serializing CBlockHeader objects for each request.
+ */
+class CHeaderCache
+{
+private:
+    struct CHeaderHasher
+    {
+        // block hashes are already the result of proof-of-work, no need to salt them
+        size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+    };
+
+    mutable CCriticalSection cs;
+    // block index of the active chain by height
+    std::vector<CBlockIndex*> vIndex;
+    // serialized headers by height, HEADER_CACHE_ENTRY_SIZE bytes each
+    std::vector<char> vchHeaders;
+    boost::unordered_map<uint256, int, CHeaderHasher> mapHeight;
+
+    /** Height of the first locator entry found in the cache, genesis if none is */
+    int FindFork(const CBlockLocator& locator) const;
+    /** Height of the last entry to send after nStartHeight, stopping at nLimit entries or hashStop */
+    int FindLast(int nStartHeight, const uint256& hashStop, int nLimit) const;
+
+public:
+    /** Make the cache reflect the active chain ending in pindexNew, NULL clears it */
+    void SetTip(CBlockIndex* pindexNew);
+    void Clear();
+
+    /**
+     * Append a headers message payload for the blocks following the locator to ssRet,
+     * up to nLimit headers and including hashStop. Returns the last block sent or NULL
+     * if there was nothing to send.
+     */
+    CBlockIndex* GetHeaders(const CBlockLocator& locator, const uint256& hashStop, int nLimit, CDataStream& ssRet) const;
+    /** Collect up to nLimit blocks following the locator, stopping before hashStop */
+    void GetBlocks(const CBlockLocator& locator, const uint256& hashStop, int nLimit, std::vector<CBlockIndex*>& vRet) const;
+
+    int Height() const;
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif
@@ -0,0 +1,104 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "iblt.h"
+
+#include "hash.h"
+#include "uint256.h"
+
+CInvertibleBloomLookupTable::CInvertibleBloomLookupTable(unsigned int nCells, uint64_t nSaltIn) :
+    nSalt(nSaltIn),
+    vCells((nCells + IBLT_HASH_FUNCS - 1) / IBLT_HASH_FUNCS * IBLT_HASH_FUNCS)
+{}
+
+uint32_t CInvertibleBloomLookupTable::CheckSum(uint64_t nKey) const
+{
+    // the hash functions used for the cell indexes are 0..IBLT_HASH_FUNCS-1
+    return (uint32_t)CSipHasher(nSalt, IBLT_HASH_FUNCS).Write(nKey).Finalize();
+}
+
+void CInvertibleBloomLookupTable::Update(uint64_t nKey, int nDelta, std::vector<size_t>* pvCellsRet)
+{
+    if(vCells.empty()) return;
+
+    uint32_t nCheckSum = CheckSum(nKey);
+    // every hash function has its own subtable so a key never lands twice in the same cell
+    size_t nSubtableSize = vCells.size() / IBLT_HASH_FUNCS;
+    for(unsigned int i = 0; i < IBLT_HASH_FUNCS; i++) {
+        size_t nCell = i * nSubtableSize + CSipHasher(nSalt, i).Write(nKey).Finalize() % nSubtableSize;
+        if(pvCellsRet) pvCellsRet->push_back(nCell);
+        CCell& cell = vCells[nCell];
+        cell.nCount += nDelta;
+        cell.nKeySum ^= nKey;
+        cell.nCheckSum ^= nCheckSum;
+    }
+}
+
+uint64_t CInvertibleBloomLookupTable::GetShortId(const uint256& hash) const
+{
+    return SipHashUint256(nSalt, IBLT_HASH_FUNCS + 1, hash);
+}
+
+void CInvertibleBloomLookupTable::insert(uint64_t nKey)
+{
+    Update(nKey, 1);
+}
+
+void CInvertibleBloomLookupTable::insert(const uint256& hash)
+{
+    Update(GetShortId(hash), 1);
+}
+
+void CInvertibleBloomLookupTable::erase(uint64_t nKey)
+{
+    Update(nKey, -1);
+}
+
+bool CInvertibleBloomLookupTable::Subtract(const CInvertibleBloomLookupTable& other)
+{
+    if(other.nSalt != nSalt || other.vCells.size() != vCells.size()) return false;
+
+    for(size_t i = 0; i < vCells.size(); i++) {
+        vCells[i].nCount -= other.vCells[i].nCount;
+        vCells[i].nKeySum ^= other.vCells[i].nKeySum;
+        vCells[i].nCheckSum ^= other.vCells[i].nCheckSum;
+    }
+    return true;
+}
+
+bool CInvertibleBloomLookupTable::Decode(std::set<uint64_t>& setPositiveRet, std::set<uint64_t>& setNegativeRet) const
+{
+    CInvertibleBloomLookupTable table(*this);
+
+    // peel off the keys of pure cells, only the cells a peeled key was removed
+    // from can have become pure, so each cell is looked at a bounded number of times
+    std::vector<size_t> vCandidates;
+    for(size_t i = 0; i < table.vCells.size(); i++) {
+        if(table.vCells[i].nCount == 1 || table.vCells[i].nCount == -1) vCandidates.push_back(i);
+    }
+    while(!vCandidates.empty()) {
+        const CCell& cell = table.vCells[vCandidates.back()];
+        vCandidates.pop_back();
+        if(cell.nCount != 1 && cell.nCount != -1) continue;
+        if(cell.nCheckSum != table.CheckSum(cell.nKeySum)) continue;
+
+        uint64_t nKey = cell.nKeySum;
+        int nCount = cell.nCount;
+        std::set<uint64_t>& setRet = nCount == 1 ? setPositiveRet : setNegativeRet;
+        // a key can only come out once, anything else is a crafted table
+        if(!setRet.insert(nKey).second) return false;
+        if(setPositiveRet.size() + setNegativeRet.size() > vCells.size()) return false;
+        table.Update(nKey, -nCount, &vCandidates);
+    }
+
+    for(size_t i = 0; i < table.vCells.size(); i++) {
+        if(!table.vCells[i].IsEmpty()) return false;
+    }
+    return true;
+}
+
+bool CInvertibleBloomLookupTable::IsWithinSizeConstraints() const
+{
+    return !vCells.empty() && vCells.size() <= MAX_IBLT_CELLS && vCells.size() % IBLT_HASH_FUNCS == 0;
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef IBLT_H
+#define IBLT_H
+
+#include "serialize.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class uint256;
+
+//! 16 bytes per cell, keeps a table below the size of a maximal bloom filter
+static const unsigned int MAX_IBLT_CELLS = 2250;
+//! number of cells every key is added to, one in each subtable
+static const unsigned int IBLT_HASH_FUNCS = 3;
+
+/**
+ * Invertible bloom lookup table of 64-bit keys, used for set reconciliation.
+ *
+ * Both sides insert their set into a table of the same size and salt, one side
+ * subtracts the other's table from its own and Decode() recovers the keys which
+ * are only in one of the sets. Decoding succeeds with high probability as long
+ * as the difference is below ~2/3 of the number of cells, independently of the
+ * size of the sets themselves.
+ *
+ * Full hashes are mapped to salted 64-bit short ids with GetShortId(), so
+ * a peer can't make two items collide without knowing the salt.
+ */
+class CInvertibleBloomLookupTable
+{
+private:
+    struct CCell
+    {
+        int32_t nCount;
+        uint64_t nKeySum;
+        uint32_t nCheckSum;
+
+        CCell() : nCount(0), nKeySum(0), nCheckSum(0) {}
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+            READWRITE(nCount);
+            READWRITE(nKeySum);
+            READWRITE(nCheckSum);
+        }
+
+        bool IsEmpty() const { return nCount == 0 && nKeySum == 0 && nCheckSum == 0; }
+    };
+
+    uint64_t nSalt;
+    std::vector<CCell> vCells;
+
+    uint32_t CheckSum(uint64_t nKey) const;
+    /// Add nKey nDelta times, the indexes of the cells it lands in are appended to pvCellsRet if given
+    void Update(uint64_t nKey, int nDelta, std::vector<size_t>* pvCellsRet = NULL);
+
+public:
+    /// An empty table, the number of cells is rounded up to a multiple of IBLT_HASH_FUNCS
+    CInvertibleBloomLookupTable(unsigned int nCells, uint64_t nSaltIn);
+    CInvertibleBloomLookupTable() : nSalt(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nSalt);
+        READWRITE(vCells);
+    }
+
+    uint64_t GetSalt() const { return nSalt; }
+    unsigned int size() const { return vCells.size(); }
+
+    uint64_t GetShortId(const uint256& hash) const;
+
+    void insert(uint64_t nKey);
+    void insert(const uint256& hash);
+    void erase(uint64_t nKey);
+
+    /// Subtract other from this table, fails if the tables don't have the same size and salt
+    bool Subtract(const CInvertibleBloomLookupTable& other);
+
+    /**
+     * Recover the keys of a table which other tables were subtracted from.
+     * Keys inserted with a positive net count go into setPositiveRet, the others into setNegativeRet.
+     * Returns false if the table could not be decoded completely.
+     */
+    bool Decode(std::set<uint64_t>& setPositiveRet, std::set<uint64_t>& setNegativeRet) const;
+
+    //! True if the number of cells is a non zero multiple of IBLT_HASH_FUNCS and <= MAX_IBLT_CELLS
+    //! (catch a table which was just deserialized which was too big)
+    bool IsWithinSizeConstraints() const;
+};
+
+#endif
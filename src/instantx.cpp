@@ -58,14 +58,18 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
         CTxLockVote vote;
         vRecv >> vote;
 
-        LOCK2(cs_main, cs_instantsend);
-
         uint256 nVoteHash = vote.GetHash();
 
-        if(mapTxLockVotes.count(nVoteHash)) return;
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        {
+            LOCK(cs_instantsend);
+            if(mapTxLockVotes.count(nVoteHash)) return;
+            mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        }
 
-        ProcessTxLockVote(pfrom, vote);
+        // let the vote threads check it, unless they can't keep up
+        if(!QueueTxLockVote(pfrom, vote)) {
+            ProcessTxLockVote(pfrom, vote);
+        }
 
         return;
     }
@@ -114,7 +118,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
     std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     CTxLockCandidate& txLockCandidate = itLockCandidate->second;
     Vote(txLockCandidate);
-    ProcessOrphanTxLockVotes();
+    ProcessOrphanTxLockVotes(txHash);
 
     // Masternodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - lock inputs, resolve conflicting locks, update transaction status
@@ -143,6 +147,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
             txLockCandidate.AddOutPointLock(txin.prevout);
         }
         mapTxLockCandidates.insert(std::make_pair(txHash, txLockCandidate));
+        PublishLockStatus(txHash);
     } else {
         LogPrint("instantsend", "CInstantSend::CreateTxLockCandidate -- seen, txid=%s\n", txHash.ToString());
     }
@@ -228,6 +233,7 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
         if(itOutpointLock->second.AddVote(vote)) {
             LogPrintf("CInstantSend::Vote -- Vote created successfully, relaying: txHash=%s, outpoint=%s, vote=%s\n",
                     txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
+            PublishLockStatus(txHash);
 
             if(itVoted == mapVotedOutpoints.end()) {
                 std::set<uint256> setHashes;
@@ -252,23 +258,31 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
 //received a consensus vote
 bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
 {
-    LOCK2(cs_main, cs_instantsend);
-
     uint256 txHash = vote.GetTxHash();
 
+    // rank lookup and signature check take the locks they need themselves,
+    // only hold cs_main and cs_instantsend to apply the vote
     if(!vote.IsValid(pfrom)) {
         // could be because of missing MN
         LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Vote is invalid, txid=%s\n", txHash.ToString());
         return false;
     }
 
+    LOCK2(cs_main, cs_instantsend);
+
     // Masternodes will sometimes propagate votes before the transaction is known to the client,
     // will actually process only after the lock request itself has arrived
 
     std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) {
         if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
-            mapTxLockVotesOrphan[vote.GetHash()] = vote;
+            if(!AddOrphanTxLockVote(vote)) {
+                LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- masternode has too many orphan Transaction Lock Votes: txid=%s  masternode=%s\n",
+                        txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
+                // forget we saw it so it neither stays around forever nor is blocked once accepted later
+                mapTxLockVotes.erase(vote.GetHash());
+                return false;
+            }
             LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s new\n",
                     txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
             bool fReprocess = true;
@@ -297,7 +311,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
 
         int nMasternodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
         if(!mapMasternodeOrphanVotes.count(vote.GetMasternodeOutpoint())) {
-            mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+            SetMasternodeOrphanVoteTime(vote.GetMasternodeOutpoint(), nMasternodeOrphanExpireTime);
         } else {
             int64_t nPrevOrphanVote = mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()];
             if(nPrevOrphanVote > GetTime() && nPrevOrphanVote > GetAverageMasternodeOrphanVoteTime()) {
@@ -307,7 +321,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
                 return false;
             }
             // not spamming, refresh
-            mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+            SetMasternodeOrphanVoteTime(vote.GetMasternodeOutpoint(), nMasternodeOrphanExpireTime);
         }
 
         return true;
@@ -348,6 +362,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
         // this should never happen
         return false;
     }
+    PublishLockStatus(txHash);
 
     int nSignatures = txLockCandidate.CountVotes();
     int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
@@ -361,17 +376,132 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
     return true;
 }
 
-void CInstantSend::ProcessOrphanTxLockVotes()
+bool CInstantSend::QueueTxLockVote(CNode* pfrom, const CTxLockVote& vote)
+{
+    boost::unique_lock<boost::mutex> lock(cs_votequeue);
+    if(nVoteThreads == 0 || listVotesPending.size() >= MAX_PENDING_VOTES) return false;
+    listVotesPending.push_back(std::make_pair(pfrom->AddRef(), vote));
+    condVoteQueue.notify_one();
+    return true;
+}
+
+void CInstantSend::ThreadVoteVerification()
+{
+    while(true) {
+        std::pair<CNode*, CTxLockVote> pairVote;
+        {
+            boost::unique_lock<boost::mutex> lock(cs_votequeue);
+            while(listVotesPending.empty())
+                condVoteQueue.wait(lock);
+            pairVote = listVotesPending.front();
+            listVotesPending.pop_front();
+        }
+        ProcessTxLockVote(pairVote.first, pairVote.second);
+        pairVote.first->Release();
+    }
+}
+
+void CInstantSend::StartVoteThreads(boost::thread_group& threadGroup)
+{
+    if(fLiteMode) return;
+
+    int nThreads = std::min(std::max(GetNumCores(), 1), MAX_INSTANTSEND_VOTE_THREADS);
+    {
+        boost::unique_lock<boost::mutex> lock(cs_votequeue);
+        nVoteThreads = nThreads;
+    }
+
+    LogPrintf("CInstantSend::StartVoteThreads -- Using %d threads for vote verification\n", nThreads);
+    for(int i = 0; i < nThreads; i++) {
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "isvote",
+                                              boost::function<void()>(boost::bind(&CInstantSend::ThreadVoteVerification, this))));
+    }
+}
+
+void CInstantSend::ProcessOrphanTxLockVotes(const uint256& txHash)
 {
     LOCK2(cs_main, cs_instantsend);
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(ProcessTxLockVote(NULL, it->second)) {
-            mapTxLockVotesOrphan.erase(it++);
-        } else {
-            ++it;
+    // only votes for this tx can have lost their orphan status
+    std::vector<uint256> vecVoteHashes = GetOrphanTxLockVoteHashes(txHash);
+    BOOST_FOREACH(const uint256& nVoteHash, vecVoteHashes) {
+        std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.find(nVoteHash);
+        if(it == mapTxLockVotesOrphan.end()) continue;
+        CTxLockVote vote = it->second;
+        if(ProcessTxLockVote(NULL, vote)) {
+            RemoveOrphanTxLockVote(nVoteHash);
+        }
+    }
+}
+
+bool CInstantSend::AddOrphanTxLockVote(const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    uint256 nVoteHash = vote.GetHash();
+    if(mapTxLockVotesOrphan.count(nVoteHash)) return true;
+
+    if(mapMasternodeOrphanVoteCount[vote.GetMasternodeOutpoint()] >= MAX_MASTERNODE_ORPHAN_VOTES) return false;
+
+    if(mapTxLockVotesOrphan.size() >= MAX_ORPHAN_VOTES) {
+        // drop the oldest one, forget we saw it so it can be received again
+        uint256 nOldestHash = setOrphanVotesByTime.begin()->second;
+        LogPrint("instantsend", "CInstantSend::AddOrphanTxLockVote -- Too many orphan votes, removing vote %s\n", nOldestHash.ToString());
+        RemoveOrphanTxLockVote(nOldestHash);
+        mapTxLockVotes.erase(nOldestHash);
+    }
+
+    mapTxLockVotesOrphan.insert(std::make_pair(nVoteHash, vote));
+    mapOrphanVotesByTxOutpoint[std::make_pair(vote.GetTxHash(), vote.GetOutpoint())].insert(nVoteHash);
+    setOrphanVotesByTime.insert(std::make_pair(vote.GetTimeCreated(), nVoteHash));
+    mapMasternodeOrphanVoteCount[vote.GetMasternodeOutpoint()]++;
+    return true;
+}
+
+void CInstantSend::RemoveOrphanTxLockVote(const uint256& nVoteHash)
+{
+    AssertLockHeld(cs_instantsend);
+
+    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.find(nVoteHash);
+    if(it == mapTxLockVotesOrphan.end()) return;
+    const CTxLockVote& vote = it->second;
+
+    std::pair<uint256, COutPoint> key = std::make_pair(vote.GetTxHash(), vote.GetOutpoint());
+    std::map<std::pair<uint256, COutPoint>, std::set<uint256> >::iterator itTxOutpoint = mapOrphanVotesByTxOutpoint.find(key);
+    if(itTxOutpoint != mapOrphanVotesByTxOutpoint.end()) {
+        itTxOutpoint->second.erase(nVoteHash);
+        if(itTxOutpoint->second.empty()) mapOrphanVotesByTxOutpoint.erase(itTxOutpoint);
+    }
+
+    setOrphanVotesByTime.erase(std::make_pair(vote.GetTimeCreated(), nVoteHash));
+
+    std::map<COutPoint, int>::iterator itCount = mapMasternodeOrphanVoteCount.find(vote.GetMasternodeOutpoint());
+    if(itCount != mapMasternodeOrphanVoteCount.end() && --itCount->second <= 0) {
+        mapMasternodeOrphanVoteCount.erase(itCount);
+    }
+
+    mapTxLockVotesOrphan.erase(it);
+}
+
+std::vector<uint256> CInstantSend::GetOrphanTxLockVoteHashes(const uint256& txHash, const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_instantsend);
+
+    std::vector<uint256> vecRet;
+    if(!outpoint.IsNull()) {
+        std::map<std::pair<uint256, COutPoint>, std::set<uint256> >::iterator it = mapOrphanVotesByTxOutpoint.find(std::make_pair(txHash, outpoint));
+        if(it != mapOrphanVotesByTxOutpoint.end()) {
+            vecRet.assign(it->second.begin(), it->second.end());
         }
+        return vecRet;
     }
+
+    // COutPoint(uint256(), 0) is the smallest outpoint, start with the first entry for this tx
+    std::map<std::pair<uint256, COutPoint>, std::set<uint256> >::iterator it = mapOrphanVotesByTxOutpoint.lower_bound(std::make_pair(txHash, COutPoint(uint256(), 0)));
+    while(it != mapOrphanVotesByTxOutpoint.end() && it->first.first == txHash) {
+        vecRet.insert(vecRet.end(), it->second.begin(), it->second.end());
+        ++it;
+    }
+    return vecRet;
 }
 
 bool CInstantSend::IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest)
@@ -389,20 +519,10 @@ bool CInstantSend::IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest)
 
 bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint)
 {
-    // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
+    // Check if this outpoint has enough orphan votes to be locked in some tx.
     LOCK2(cs_main, cs_instantsend);
-    int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
-            nCountVotes++;
-            if(nCountVotes >= COutPointLock::SIGNATURES_REQUIRED) {
-                return true;
-            }
-        }
-        ++it;
-    }
-    return false;
+    std::map<std::pair<uint256, COutPoint>, std::set<uint256> >::iterator it = mapOrphanVotesByTxOutpoint.find(std::make_pair(txHash, outpoint));
+    return it != mapOrphanVotesByTxOutpoint.end() && (int)it->second.size() >= COutPointLock::SIGNATURES_REQUIRED;
 }
 
 void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate)
@@ -460,14 +580,48 @@ void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate
         mapLockedOutpoints.insert(std::make_pair(it->first, txHash));
         ++it;
     }
+    PublishLockStatus(txHash);
     LogPrint("instantsend", "CInstantSend::LockTransactionInputs -- done, txid=%s\n", txHash.ToString());
 }
 
+void CInstantSend::PublishLockStatus(const uint256& txHash)
+{
+    AssertLockHeld(cs_instantsend);
+
+    std::map<uint256, CTxLockCandidate>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    if(itLockCandidate == mapTxLockCandidates.end()) {
+        LOCK(cs_lockstatus);
+        lockStatus.mapTxStatus.erase(txHash);
+        return;
+    }
+    const CTxLockCandidate& txLockCandidate = itLockCandidate->second;
+
+    // count votes outside of cs_lockstatus, readers only wait for the map updates
+    CInstantSendLockStatus::tx_status_t status;
+    status.nSignatures = txLockCandidate.CountVotes();
+    // locked if there are outpoints and all of them are included in mapLockedOutpoints with correct hash
+    status.fLocked = !txLockCandidate.mapOutPointLocks.empty();
+
+    LOCK(cs_lockstatus);
+    std::map<COutPoint, COutPointLock>::const_iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
+    for(; itOutpointLock != txLockCandidate.mapOutPointLocks.end(); ++itOutpointLock) {
+        std::map<COutPoint, uint256>::const_iterator it = mapLockedOutpoints.find(itOutpointLock->first);
+        if(it == mapLockedOutpoints.end()) {
+            lockStatus.mapLockedOutpoints.erase(itOutpointLock->first);
+            status.fLocked = false;
+        } else {
+            lockStatus.mapLockedOutpoints[it->first] = it->second;
+            status.fLocked = status.fLocked && it->second == txHash;
+        }
+    }
+    lockStatus.mapTxStatus[txHash] = status;
+}
+
 bool CInstantSend::GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet)
 {
-    LOCK(cs_instantsend);
-    std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
-    if(it == mapLockedOutpoints.end()) return false;
+    LOCK(cs_lockstatus);
+    std::map<COutPoint, uint256>::const_iterator it = lockStatus.mapLockedOutpoints.find(outpoint);
+    if(it == lockStatus.mapLockedOutpoints.end()) return false;
     hashRet = it->second;
     return true;
 }
@@ -567,15 +721,21 @@ int64_t CInstantSend::GetAverageMasternodeOrphanVoteTime()
     // NOTE: should never actually call this function when mapMasternodeOrphanVotes is empty
     if(mapMasternodeOrphanVotes.empty()) return 0;
 
-    std::map<COutPoint, int64_t>::iterator it = mapMasternodeOrphanVotes.begin();
-    int64_t total = 0;
+    return nMasternodeOrphanVoteTimeSum / (int64_t)mapMasternodeOrphanVotes.size();
+}
 
-    while(it != mapMasternodeOrphanVotes.end()) {
-        total+= it->second;
-        ++it;
-    }
+void CInstantSend::SetMasternodeOrphanVoteTime(const COutPoint& outpointMasternode, int64_t nTime)
+{
+    AssertLockHeld(cs_instantsend);
 
-    return total / mapMasternodeOrphanVotes.size();
+    std::map<COutPoint, int64_t>::iterator it = mapMasternodeOrphanVotes.find(outpointMasternode);
+    if(it != mapMasternodeOrphanVotes.end()) {
+        nMasternodeOrphanVoteTimeSum += nTime - it->second;
+        it->second = nTime;
+    } else {
+        nMasternodeOrphanVoteTimeSum += nTime;
+        mapMasternodeOrphanVotes.insert(std::make_pair(outpointMasternode, nTime));
+    }
 }
 
 void CInstantSend::CheckAndRemove()
@@ -585,6 +745,9 @@ void CInstantSend::CheckAndRemove()
     LOCK(cs_instantsend);
 
     std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
+    // txes whose lock status changed and outpoints which aren't locked anymore
+    std::set<uint256> setTxHashesChanged;
+    std::vector<COutPoint> vOutpointsUnlocked;
 
     // remove expired candidates
     while(itLockCandidate != mapTxLockCandidates.end()) {
@@ -594,17 +757,33 @@ void CInstantSend::CheckAndRemove()
             LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
             std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
             while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
-                mapLockedOutpoints.erase(itOutpointLock->first);
+                std::map<COutPoint, uint256>::iterator itLocked = mapLockedOutpoints.find(itOutpointLock->first);
+                if(itLocked != mapLockedOutpoints.end()) {
+                    // the outpoint could have been locked to another candidate
+                    setTxHashesChanged.insert(itLocked->second);
+                    vOutpointsUnlocked.push_back(itLocked->first);
+                    mapLockedOutpoints.erase(itLocked);
+                }
                 mapVotedOutpoints.erase(itOutpointLock->first);
                 ++itOutpointLock;
             }
             mapLockRequestAccepted.erase(txHash);
             mapLockRequestRejected.erase(txHash);
             mapTxLockCandidates.erase(itLockCandidate++);
+            setTxHashesChanged.insert(txHash);
         } else {
             ++itLockCandidate;
         }
     }
+    {
+        LOCK(cs_lockstatus);
+        BOOST_FOREACH(const COutPoint& outpoint, vOutpointsUnlocked) {
+            lockStatus.mapLockedOutpoints.erase(outpoint);
+        }
+    }
+    BOOST_FOREACH(const uint256& txHash, setTxHashesChanged) {
+        PublishLockStatus(txHash);
+    }
 
     // remove expired votes
     std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
@@ -618,17 +797,17 @@ void CInstantSend::CheckAndRemove()
         }
     }
 
-    // remove expired orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(GetTime() - itOrphanVote->second.GetTimeCreated() > ORPHAN_VOTE_SECONDS) {
+    // remove expired orphan votes, oldest first
+    while(!setOrphanVotesByTime.empty() && GetTime() - setOrphanVotesByTime.begin()->first > ORPHAN_VOTE_SECONDS) {
+        uint256 nVoteHash = setOrphanVotesByTime.begin()->second;
+        std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.find(nVoteHash);
+        if(itOrphanVote != mapTxLockVotesOrphan.end()) {
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: txid=%s  masternode=%s\n",
                     itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
         }
+        mapTxLockVotes.erase(nVoteHash);
+        setOrphanVotesByTime.erase(setOrphanVotesByTime.begin());
+        RemoveOrphanTxLockVote(nVoteHash);
     }
 
     // remove expired masternode orphan votes (DOS protection)
@@ -637,6 +816,7 @@ void CInstantSend::CheckAndRemove()
         if(itMasternodeOrphan->second < GetTime()) {
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan masternode vote: masternode=%s\n",
                     itMasternodeOrphan->first.ToStringShort());
+            nMasternodeOrphanVoteTimeSum -= itMasternodeOrphan->second;
             mapMasternodeOrphanVotes.erase(itMasternodeOrphan++);
         } else {
             ++itMasternodeOrphan;
@@ -709,24 +889,10 @@ bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
     if(!fEnableInstantSend || fLargeWorkForkFound || fLargeWorkInvalidChainFound ||
         !sporkManager.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED)) return false;
 
-    LOCK(cs_instantsend);
-
-    // there must be a lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-    if(itLockCandidate == mapTxLockCandidates.end()) return false;
-
-    // which should have outpoints
-    if(itLockCandidate->second.mapOutPointLocks.empty()) return false;
-
-    // and all of these outputs must be included in mapLockedOutpoints with correct hash
-    std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
-    while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
-        uint256 hashLocked;
-        if(!GetLockedOutPointTxHash(itOutpointLock->first, hashLocked) || hashLocked != txHash) return false;
-        ++itOutpointLock;
-    }
-
-    return true;
+    // there must be a lock candidate with all of its outpoints locked, see PublishLockStatus()
+    LOCK(cs_lockstatus);
+    std::map<uint256, CInstantSendLockStatus::tx_status_t>::const_iterator it = lockStatus.mapTxStatus.find(txHash);
+    return it != lockStatus.mapTxStatus.end() && it->second.fLocked;
 }
 
 int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
@@ -735,11 +901,10 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
     if(fLargeWorkForkFound || fLargeWorkInvalidChainFound) return -2;
     if(!sporkManager.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED)) return -3;
 
-    LOCK(cs_instantsend);
-
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-    if(itLockCandidate != mapTxLockCandidates.end()) {
-        return itLockCandidate->second.CountVotes();
+    LOCK(cs_lockstatus);
+    std::map<uint256, CInstantSendLockStatus::tx_status_t>::const_iterator it = lockStatus.mapTxStatus.find(txHash);
+    if(it != lockStatus.mapTxStatus.end()) {
+        return it->second.nSignatures;
     }
 
     return -1;
@@ -820,14 +985,11 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.GetTxHash() == txHash) {
-            LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                    txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
-        }
-        ++itOrphanVote;
+    std::vector<uint256> vecOrphanVoteHashes = GetOrphanTxLockVoteHashes(txHash);
+    BOOST_FOREACH(const uint256& nVoteHash, vecOrphanVoteHashes) {
+        LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
+                txHash.ToString(), nHeightNew, nVoteHash.ToString());
+        mapTxLockVotes[nVoteHash].SetConfirmedHeight(nHeightNew);
     }
 }
 
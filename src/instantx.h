@@ -29,14 +29,38 @@ static const int DEFAULT_INSTANTSEND_DEPTH          = 5;
 
 static const int MIN_INSTANTSEND_PROTO_VERSION      = 70206;
 
+//! Maximum number of threads checking lock votes
+static const int MAX_INSTANTSEND_VOTE_THREADS      = 4;
+
 extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
 extern int nCompleteTXLocks;
 
+/**
+ * Lock status of the transactions InstantSend knows about, published by CInstantSend
+ * one tx at a time whenever it changes.
+ */
+struct CInstantSendLockStatus
+{
+    struct tx_status_t
+    {
+        int nSignatures;
+        bool fLocked; // all outpoints of the tx are locked to it
+    };
+
+    std::map<uint256, tx_status_t> mapTxStatus; // tx hash - status
+    std::map<COutPoint, uint256> mapLockedOutpoints; // utxo - tx hash
+};
+
 class CInstantSend
 {
 private:
     static const int ORPHAN_VOTE_SECONDS            = 60;
+    /// Orphan votes to keep in total and per masternode, a vote takes ~300 bytes with its index entries
+    static const size_t MAX_ORPHAN_VOTES            = 10000;
+    static const int MAX_MASTERNODE_ORPHAN_VOTES    = 200;
+    /// Votes waiting for the vote threads before new ones are checked by the message handler itself
+    static const size_t MAX_PENDING_VOTES           = 1000;
 
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
@@ -46,6 +70,10 @@ private:
     std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
     std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
     std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    // indexes of mapTxLockVotesOrphan, only change them through AddOrphanTxLockVote/RemoveOrphanTxLockVote
+    std::map<std::pair<uint256, COutPoint>, std::set<uint256> > mapOrphanVotesByTxOutpoint; // tx hash, utxo - vote hash set
+    std::set<std::pair<int64_t, uint256> > setOrphanVotesByTime; // time created, vote hash
+    std::map<COutPoint, int> mapMasternodeOrphanVoteCount; // mn outpoint - number of orphan votes
 
     std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
 
@@ -54,16 +82,41 @@ private:
 
     //track masternodes who voted with no txreq (for DOS protection)
     std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; // mn outpoint - time
+    int64_t nMasternodeOrphanVoteTimeSum; // sum of mapMasternodeOrphanVotes times, for the average
+
+    // only protects lockStatus, so lock status lookups never wait for cs_instantsend
+    mutable CCriticalSection cs_lockstatus;
+    CInstantSendLockStatus lockStatus;
+
+    /// Publish the lock status of a tx and its outpoints, call after changing its lock candidate or locked outpoints
+    void PublishLockStatus(const uint256& txHash);
+
+    // votes waiting for a vote thread, nodes are referenced until then
+    CWaitableCriticalSection cs_votequeue;
+    CConditionVariable condVoteQueue;
+    std::list<std::pair<CNode*, CTxLockVote> > listVotesPending;
+    int nVoteThreads;
+
+    /// Hand a vote over to the vote threads, false if there are none or they are too far behind
+    bool QueueTxLockVote(CNode* pfrom, const CTxLockVote& vote);
+    void ThreadVoteVerification();
 
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void Vote(CTxLockCandidate& txLockCandidate);
 
     //process consensus vote message
     bool ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote);
-    void ProcessOrphanTxLockVotes();
+    void ProcessOrphanTxLockVotes(const uint256& txHash);
     bool IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest);
     bool IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint);
     int64_t GetAverageMasternodeOrphanVoteTime();
+    void SetMasternodeOrphanVoteTime(const COutPoint& outpointMasternode, int64_t nTime);
+
+    /// Store an orphan vote, evicting the oldest one if the store is full. False if its masternode has too many already.
+    bool AddOrphanTxLockVote(const CTxLockVote& vote);
+    void RemoveOrphanTxLockVote(const uint256& nVoteHash);
+    /// Hashes of the orphan votes for a tx, or only for one of its outpoints if it's not null
+    std::vector<uint256> GetOrphanTxLockVoteHashes(const uint256& txHash, const COutPoint& outpoint = COutPoint());
 
     void TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate);
     void LockTransactionInputs(const CTxLockCandidate& txLockCandidate);
@@ -76,6 +129,11 @@ private:
 public:
     CCriticalSection cs_instantsend;
 
+    CInstantSend() : pCurrentBlockIndex(NULL), nMasternodeOrphanVoteTimeSum(0), nVoteThreads(0) {}
+
+    /// Start the threads checking rank and signature of lock votes received from peers
+    void StartVoteThreads(boost::thread_group& threadGroup);
+
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
     bool ProcessTxLockRequest(const CTxLockRequest& txLockRequest);
@@ -70,6 +70,7 @@ CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
 CChain chainActive;
+CHeaderCache headercache;
 CBlockIndex *pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
@@ -212,6 +213,7 @@ namespace {
         uint256 hash;
         CBlockIndex* pindex;     //!< Optional.
         bool fValidatedHeaders;  //!< Whether this block has validated headers at the time of request.
+        int64_t nTime;           //!< Time of the request (in microseconds).
     };
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
@@ -281,6 +283,16 @@ struct CNodeState {
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
     bool fPreferHeaders;
+    //! Moving average of the time (in microseconds) it takes this peer to deliver the next queued block, or 0 if unknown.
+    int64_t nBlockTimeAvg;
+    //! Blocks and bytes received from this peer that we requested from it.
+    uint64_t nBlocksReceived;
+    uint64_t nBlockBytesReceived;
+    //! Total time (in microseconds) spent on the timed deliveries that make up nBlockTimeAvg, and their size.
+    int64_t nBlockTimeTotal;
+    uint64_t nBlockBytesTimed;
+    //! Number of blocks requested from other peers instead because this peer was too slow delivering them.
+    uint64_t nBlocksReRequested;
 
     CNodeState() {
         fCurrentlyConnected = false;
@@ -297,6 +309,12 @@ struct CNodeState {
         nBlocksInFlightValidHeaders = 0;
         fPreferredDownload = false;
         fPreferHeaders = false;
+        nBlockTimeAvg = 0;
+        nBlocksReceived = 0;
+        nBlockBytesReceived = 0;
+        nBlockTimeTotal = 0;
+        nBlockBytesTimed = 0;
+        nBlocksReRequested = 0;
     }
 };
 
@@ -363,20 +381,45 @@ void FinalizeNode(NodeId nodeid) {
     }
 }
 
+// Requires cs_main.
+// Number of blocks we allow to be in flight from this peer, sized to its measured download speed.
+int GetMaxBlocksInFlight(const CNodeState *state) {
+    if (state->nBlockTimeAvg <= 0)
+        return DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER;
+    int64_t nMax = (int64_t)BLOCK_DOWNLOAD_TARGET_QUEUE_TIME * 1000000 / state->nBlockTimeAvg;
+    return std::max<int64_t>(MIN_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER, nMax));
+}
+
 // Requires cs_main.
 // Returns a bool indicating whether we requested this block.
-bool MarkBlockAsReceived(const uint256& hash) {
+// nBlockSize is the size of the block if it was actually received from peer nodeidFrom, 0 if the request is just being dropped.
+// Only the peer the block was requested from is credited for the delivery, not one that was asked later.
+bool MarkBlockAsReceived(const uint256& hash, NodeId nodeidFrom = -1, unsigned int nBlockSize = 0) {
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
     if (itInFlight != mapBlocksInFlight.end()) {
         CNodeState *state = State(itInFlight->second.first);
+        if (itInFlight->second.first != nodeidFrom)
+            nBlockSize = 0;
         state->nBlocksInFlightValidHeaders -= itInFlight->second.second->fValidatedHeaders;
         if (state->nBlocksInFlightValidHeaders == 0 && itInFlight->second.second->fValidatedHeaders) {
             // Last validated block on the queue was received.
             nPeersWithValidatedDownloads--;
         }
+        if (nBlockSize > 0) {
+            state->nBlocksReceived++;
+            state->nBlockBytesReceived += nBlockSize;
+        }
         if (state->vBlocksInFlight.begin() == itInFlight->second.second) {
+            int64_t nNow = GetTimeMicros();
+            if (nBlockSize > 0 && nNow > state->nDownloadingSince) {
+                // The peer delivered the block it was working on, use this to estimate its speed
+                int64_t nBlockTime = nNow - state->nDownloadingSince;
+                state->nBlockTimeAvg = state->nBlockTimeAvg == 0 ? nBlockTime : (state->nBlockTimeAvg * 7 + nBlockTime) / 8;
+                state->nBlockTimeTotal += nBlockTime;
+                state->nBlockBytesTimed += nBlockSize;
+            }
             // First block on the queue was received, update the start download time for the next one
-            state->nDownloadingSince = std::max(state->nDownloadingSince, GetTimeMicros());
+            state->nDownloadingSince = std::max(state->nDownloadingSince, nNow);
         }
         state->vBlocksInFlight.erase(itInFlight->second.second);
         state->nBlocksInFlight--;
@@ -395,7 +438,7 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     // Make sure it's not listed somewhere already.
     MarkBlockAsReceived(hash);
 
-    QueuedBlock newentry = {hash, pindex, pindex != NULL};
+    QueuedBlock newentry = {hash, pindex, pindex != NULL, GetTimeMicros()};
     list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += newentry.fValidatedHeaders;
@@ -477,8 +520,35 @@ CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb) {
     return pa;
 }
 
+/** Whether the block at itQueued, in flight from peer nodeidHolder, has been delayed for so long that the
+ *  (measured to be faster) peer with state stateRequester should download it instead. */
+bool IsBlockDownloadStalled(const CNodeState *stateRequester, NodeId nodeidHolder, list<QueuedBlock>::const_iterator itQueued, int64_t nNow) {
+    if (stateRequester->nBlockTimeAvg == 0) {
+        // We don't know yet whether the requesting peer would do any better.
+        return false;
+    }
+    int64_t nInFlight = nNow - itQueued->nTime;
+    if (nInFlight < (int64_t)BLOCK_REREQUEST_TIMEOUT * 1000000 || nInFlight < 2 * stateRequester->nBlockTimeAvg) {
+        return false;
+    }
+    const CNodeState *stateHolder = State(nodeidHolder);
+    if (stateHolder->nBlockTimeAvg == 0) {
+        // Nothing to compare against yet, leave the block to the regular stalling timeouts.
+        return false;
+    }
+    // How long the holding peer should have needed for this block at its own pace, including the ones queued before it.
+    int64_t nExpected = 0;
+    for (list<QueuedBlock>::const_iterator it = stateHolder->vBlocksInFlight.begin(); it != stateHolder->vBlocksInFlight.end(); ++it) {
+        nExpected += stateHolder->nBlockTimeAvg;
+        if (it == itQueued)
+            break;
+    }
+    return nInFlight > 2 * nExpected;
+}
+
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
- *  at most count entries. */
+ *  at most count entries. If the block holding back the download window is stalled at a slower
+ *  peer, it is added as well so that it gets requested from this peer instead. */
 void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBlockIndex*>& vBlocks, NodeId& nodeStaller) {
     if (count == 0)
         return;
@@ -555,7 +625,18 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
                 }
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
-                waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                const pair<NodeId, list<QueuedBlock>::iterator>& inFlight = mapBlocksInFlight[pindex->GetBlockHash()];
+                waitingfor = inFlight.first;
+                if (waitingfor != nodeid && IsBlockDownloadStalled(state, waitingfor, inFlight.second, GetTimeMicros())) {
+                    LogPrint("net", "Block %s (%d) is stalled at peer=%d, requesting it from peer=%d\n",
+                        pindex->GetBlockHash().ToString(), pindex->nHeight, waitingfor, nodeid);
+                    State(waitingfor)->nBlocksReRequested++;
+                    waitingfor = nodeid;
+                    vBlocks.push_back(pindex);
+                    if (vBlocks.size() == count) {
+                        return;
+                    }
+                }
             }
         }
     }
@@ -575,6 +656,12 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nMaxBlocksInFlight = GetMaxBlocksInFlight(state);
+    stats.nBlocksReceived = state->nBlocksReceived;
+    stats.nBlockBytesReceived = state->nBlockBytesReceived;
+    stats.nBlockTimeAvg = state->nBlockTimeAvg;
+    stats.nBlockBytesPerSecond = state->nBlockTimeTotal > 0 ? state->nBlockBytesTimed * 1000000 / state->nBlockTimeTotal : 0;
+    stats.nBlocksReRequested = state->nBlocksReRequested;
     return true;
 }
 
@@ -3115,6 +3202,7 @@ void PruneAndFlush() {
 void static UpdateTip(CBlockIndex *pindexNew) {
     const CChainParams& chainParams = Params();
     chainActive.SetTip(pindexNew);
+    headercache.SetTip(pindexNew);
 
     // New best block
     nTimeBestReceived = GetTime();
@@ -3210,6 +3298,7 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
     mempool.UpdateTransactionsFromBlock(vHashUpdate);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
+    mnodeman.BlockDisconnected(block, pindexDelete);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     BOOST_FOREACH(const CTransaction &tx, block.vtx) {
@@ -3269,6 +3358,7 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted, !IsInitialBlockDownload());
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
+    mnodeman.BlockConnected(*pblock, pindexNew);
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH(const CTransaction &tx, txConflicted) {
@@ -4171,7 +4261,7 @@ bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, c
 
     {
         LOCK(cs_main);
-        bool fRequested = MarkBlockAsReceived(pblock->GetHash());
+        bool fRequested = MarkBlockAsReceived(pblock->GetHash(), pfrom ? pfrom->GetId() : -1, ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
         fRequested |= fForceProcessing;
         if (!checked) {
             return error("%s: CheckBlock FAILED", __func__);
@@ -4506,6 +4596,7 @@ bool static LoadBlockIndexDB()
     if (it == mapBlockIndex.end())
         return true;
     chainActive.SetTip(it->second);
+    headercache.SetTip(it->second);
 
     PruneBlockIndexCandidates();
 
@@ -4610,6 +4701,7 @@ void UnloadBlockIndex()
     LOCK(cs_main);
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    headercache.Clear();
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
     mempool.clear();
@@ -5235,18 +5327,11 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             }
             else if (inv.IsKnownType())
             {
-                // Send stream from relay memory
+                // Send stream from relay memory, only RelayTransaction puts anything there
                 bool pushed = false;
-                {
+                if (inv.type == MSG_TX || inv.type == MSG_TXLOCK_REQUEST || inv.type == MSG_DSTX) {
                     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                    {
-                        LOCK(cs_mapRelay);
-                        map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
-                        if (mi != mapRelay.end()) {
-                            ss += (*mi).second;
-                            pushed = true;
-                        }
-                    }
+                    pushed = relaycache.Get(inv, ss);
                     if(pushed)
                         pfrom->PushMessage(inv.GetCommand(), ss);
                 }
@@ -5734,7 +5819,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                     pfrom->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), inv.hash);
                     CNodeState *nodestate = State(pfrom->GetId());
                     if (CanDirectFetch(chainparams.GetConsensus()) &&
-                        nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                        nodestate->nBlocksInFlight < GetMaxBlocksInFlight(nodestate)) {
                         vToFetch.push_back(inv);
                         // Mark block as in flight already, even though the actual "getdata" message only goes out
                         // later (within the same cs_main lock, though).
@@ -5792,6 +5877,26 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         uint256 hashStop;
         vRecv >> locator >> hashStop;
 
+        int nLimit = 500;
+        if (!fPruneMode)
+        {
+            // Nothing is pruned, so everything in the active chain can be announced
+            // and the answer is taken from the header cache without locking cs_main
+            std::vector<CBlockIndex*> vBlocks;
+            headercache.GetBlocks(locator, hashStop, nLimit, vBlocks);
+            LogPrint("net", "getblocks %d to %s limit %d from peer=%d\n", (vBlocks.empty() ? -1 : vBlocks.front()->nHeight), hashStop.IsNull() ? "end" : hashStop.ToString(), nLimit, pfrom->id);
+            BOOST_FOREACH(CBlockIndex* pindex, vBlocks)
+                pfrom->PushInventory(CInv(MSG_BLOCK, pindex->GetBlockHash()));
+            if ((int)vBlocks.size() >= nLimit)
+            {
+                // When this block is requested, we'll send an inv that'll
+                // trigger the peer to getblocks the next batch of inventory.
+                LogPrint("net", "  getblocks stopping at limit %d %s\n", vBlocks.back()->nHeight, vBlocks.back()->GetBlockHash().ToString());
+                pfrom->hashContinue = vBlocks.back()->GetBlockHash();
+            }
+            return true;
+        }
+
         LOCK(cs_main);
 
         // Find the last block the caller has in the main chain
@@ -5800,7 +5905,6 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         // Send the rest of the chain
         if (pindex)
             pindex = chainActive.Next(pindex);
-        int nLimit = 500;
         LogPrint("net", "getblocks %d to %s limit %d from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), nLimit, pfrom->id);
         for (; pindex; pindex = chainActive.Next(pindex))
         {
@@ -5836,46 +5940,41 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         uint256 hashStop;
         vRecv >> locator >> hashStop;
 
-        LOCK(cs_main);
         if (IsInitialBlockDownload() && !pfrom->fWhitelisted) {
             LogPrint("net", "Ignoring getheaders from peer=%d because node is in initial block download\n", pfrom->id);
             return true;
         }
 
-        CNodeState *nodestate = State(pfrom->GetId());
         CBlockIndex* pindex = NULL;
+        CDataStream ssHeaders(SER_NETWORK, PROTOCOL_VERSION);
         if (locator.IsNull())
         {
             // If locator is null, return the hashStop block
+            LOCK(cs_main);
             BlockMap::iterator mi = mapBlockIndex.find(hashStop);
             if (mi == mapBlockIndex.end())
                 return true;
             pindex = (*mi).second;
+            // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
+            ssHeaders << vector<CBlock>(1, pindex->GetBlockHeader());
         }
         else
         {
-            // Find the last block the caller has in the main chain
-            pindex = FindForkInGlobalIndex(chainActive, locator);
-            if (pindex)
-                pindex = chainActive.Next(pindex);
+            // Slice the headers following the last block the caller has in the
+            // main chain out of the pre-serialized header cache
+            pindex = headercache.GetHeaders(locator, hashStop, MAX_HEADERS_RESULTS, ssHeaders);
         }
+        LogPrint("net", "getheaders to %d %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
 
-        // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
-        vector<CBlock> vHeaders;
-        int nLimit = MAX_HEADERS_RESULTS;
-        LogPrint("net", "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
-        for (; pindex; pindex = chainActive.Next(pindex))
         {
-            vHeaders.push_back(pindex->GetBlockHeader());
-            if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
-                break;
+            LOCK(cs_main);
+            // pindex can be NULL either if we sent chainActive.Tip() OR
+            // if our peer has chainActive.Tip() (and thus we are sending an empty
+            // headers message). In both cases it's safe to update
+            // pindexBestHeaderSent to be our tip.
+            State(pfrom->GetId())->pindexBestHeaderSent = pindex ? pindex : chainActive.Tip();
         }
-        // pindex can be NULL either if we sent chainActive.Tip() OR
-        // if our peer has chainActive.Tip() (and thus we are sending an empty
-        // headers message). In both cases it's safe to update
-        // pindexBestHeaderSent to be our tip.
-        nodestate->pindexBestHeaderSent = pindex ? pindex : chainActive.Tip();
-        pfrom->PushMessage(NetMsgType::HEADERS, vHeaders);
+        pfrom->PushMessage(NetMsgType::HEADERS, ssHeaders);
     }
 
 
@@ -5948,6 +6047,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             LogPrintf("DSTX -- Got Masternode transaction %s\n", hashTx.ToString());
             mempool.PrioritiseTransaction(hashTx, hashTx.ToString(), 1000, 0.1*COIN);
             pmn->fAllowMixingTx = false;
+            mnodeman.MarkCacheChanged();
         }
 
         LOCK(cs_main);
@@ -6154,7 +6254,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             vector<CBlockIndex *> vToFetch;
             CBlockIndex *pindexWalk = pindexLast;
             // Calculate all the blocks we'd need to switch to pindexLast, up to a limit.
-            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= (size_t)GetMaxBlocksInFlight(nodestate)) {
                 if (!(pindexWalk->nStatus & BLOCK_HAVE_DATA) &&
                         !mapBlocksInFlight.count(pindexWalk->GetBlockHash())) {
                     // We don't have this block, and it's not yet in flight.
@@ -6174,7 +6274,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 vector<CInv> vGetData;
                 // Download as much as possible, from earliest to latest.
                 BOOST_REVERSE_FOREACH(CBlockIndex *pindex, vToFetch) {
-                    if (nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                    if (nodestate->nBlocksInFlight >= GetMaxBlocksInFlight(nodestate)) {
                         // Can't download any more from this peer
                         break;
                     }
@@ -6614,6 +6714,37 @@ bool ProcessMessages(CNode* pfrom)
     return fOk;
 }
 
+namespace {
+
+enum InvSendPriority {
+    INV_PRIORITY_BLOCK = 0,
+    INV_PRIORITY_INSTANTSEND = 1,
+    INV_PRIORITY_NORMAL = 2,
+};
+
+InvSendPriority GetInvSendPriority(int nInvType)
+{
+    switch (nInvType) {
+        case MSG_BLOCK:
+        case MSG_FILTERED_BLOCK:
+            return INV_PRIORITY_BLOCK;
+        case MSG_TXLOCK_REQUEST:
+        case MSG_TXLOCK_VOTE:
+            return INV_PRIORITY_INSTANTSEND;
+        default:
+            return INV_PRIORITY_NORMAL;
+    }
+}
+
+struct CompareInvSendPriority
+{
+    bool operator()(const CInv& a, const CInv& b) const
+    {
+        return GetInvSendPriority(a.type) < GetInvSendPriority(b.type);
+    }
+};
+
+} // anon namespace
 
 bool SendMessages(CNode* pto)
 {
@@ -6853,56 +6984,42 @@ bool SendMessages(CNode* pto)
         // Message: inventory
         //
         vector<CInv> vInv;
-        vector<CInv> vInvWait;
         {
+            LOCK(pto->cs_inventory);
             bool fSendTrickle = pto->fWhitelisted;
             if (pto->nNextInvSend < nNow) {
                 fSendTrickle = true;
                 pto->nNextInvSend = PoissonNextSend(nNow, AVG_INVENTORY_BROADCAST_INTERVAL);
             }
-            LOCK(pto->cs_inventory);
-            vInv.reserve(std::min<size_t>(1000, pto->vInventoryToSend.size()));
-            vInvWait.reserve(pto->vInventoryToSend.size());
+
+            // Everything but blocks and InstantSend locks waits for the peer's
+            // randomized trickle timer so that announcements go out in batches
+            vector<CInv> vInvWait;
+            vInv.reserve(pto->vInventoryToSend.size());
             BOOST_FOREACH(const CInv& inv, pto->vInventoryToSend)
             {
+                // the filter doesn't know the type, other invs share their hash with a tx
+                // or have to be sent again on every sync request
                 if (inv.type == MSG_TX && pto->filterInventoryKnown.contains(inv.hash))
                     continue;
 
-                // trickle out tx inv to protect privacy
-                if (inv.type == MSG_TX && !fSendTrickle)
-                {
-                    // 1/4 of tx invs blast to all immediately
-                    static uint256 hashSalt;
-                    if (hashSalt.IsNull())
-                        hashSalt = GetRandHash();
-                    uint256 hashRand = ArithToUint256(UintToArith256(inv.hash) ^ UintToArith256(hashSalt));
-                    hashRand = Hash(BEGIN(hashRand), END(hashRand));
-                    bool fTrickleWait = ((UintToArith256(hashRand) & 3) != 0);
-
-                    if (fTrickleWait)
-                    {
-                        LogPrint("net", "SendMessages -- queued inv(vInvWait): %s  index=%d peer=%d\n", inv.ToString(), vInvWait.size(), pto->id);
-                        vInvWait.push_back(inv);
-                        continue;
-                    }
+                if (!fSendTrickle && GetInvSendPriority(inv.type) == INV_PRIORITY_NORMAL) {
+                    vInvWait.push_back(inv);
+                    continue;
                 }
 
                 pto->filterInventoryKnown.insert(inv.hash);
-
-                LogPrint("net", "SendMessages -- queued inv: %s  index=%d peer=%d\n", inv.ToString(), vInv.size(), pto->id);
                 vInv.push_back(inv);
-                if (vInv.size() >= 1000)
-                {
-                    LogPrint("net", "SendMessages -- pushing inv's: count=%d peer=%d\n", vInv.size(), pto->id);
-                    pto->PushMessage(NetMsgType::INV, vInv);
-                    vInv.clear();
-                }
             }
-            pto->vInventoryToSend = vInvWait;
+            pto->vInventoryToSend.swap(vInvWait);
         }
         if (!vInv.empty()) {
-            LogPrint("net", "SendMessages -- pushing tailing inv's: count=%d peer=%d\n", vInv.size(), pto->id);
-            pto->PushMessage(NetMsgType::INV, vInv);
+            std::stable_sort(vInv.begin(), vInv.end(), CompareInvSendPriority());
+            for (size_t i = 0; i < vInv.size(); i += MAX_INV_SEND_SZ) {
+                vector<CInv> vInvChunk(vInv.begin() + i, vInv.begin() + std::min(vInv.size(), i + MAX_INV_SEND_SZ));
+                LogPrint("net", "SendMessages -- pushing inv's: count=%d peer=%d\n", vInvChunk.size(), pto->id);
+                pto->PushMessage(NetMsgType::INV, vInvChunk);
+            }
         }
 
         // Detect whether we're stalling
@@ -6932,10 +7049,11 @@ bool SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         vector<CInv> vGetData;
-        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        int nMaxBlocksInFlight = GetMaxBlocksInFlight(&state);
+        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < nMaxBlocksInFlight) {
             vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
+            FindNextBlocksToDownload(pto->GetId(), nMaxBlocksInFlight - state.nBlocksInFlight, vToDownload, staller);
             BOOST_FOREACH(CBlockIndex *pindex, vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), consensusParams, pindex);
@@ -15,6 +15,7 @@
 #include "amount.h"
 #include "chain.h"
 #include "coins.h"
+#include "headercache.h"
 #include "net.h"
 #include "script/script_error.h"
 #include "sync.h"
@@ -79,8 +80,16 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
-static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Number of blocks that can be requested at any given time from a single peer whose download speed is not known yet. */
+static const int DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Lower bound of the adaptive per-peer in-flight block limit. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+/** Upper bound of the adaptive per-peer in-flight block limit. */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 64;
+/** Seconds worth of downloads (at the peer's measured speed) to keep in flight from each peer. */
+static const int BLOCK_DOWNLOAD_TARGET_QUEUE_TIME = 4;
+/** Minimum time in seconds the block holding back the download window must be in flight before a faster peer may fetch it instead. */
+static const unsigned int BLOCK_REREQUEST_TIMEOUT = 1;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -89,7 +98,7 @@ static const unsigned int MAX_HEADERS_RESULTS = 2000;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
- *  harder). We'll probably want to make this a per-peer adaptive value at some point. */
+ *  harder). How much of it each peer may have in flight is sized adaptively, see GetMaxBlocksInFlight. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
@@ -101,9 +110,11 @@ static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 static const unsigned int AVG_LOCAL_ADDRESS_BROADCAST_INTERVAL = 24 * 24 * 60;
 /** Average delay between peer address broadcasts in seconds. */
 static const unsigned int AVG_ADDRESS_BROADCAST_INTERVAL = 30;
-/** Average delay between trickled inventory broadcasts in seconds.
- *  Blocks, whitelisted receivers, and a random 25% of transactions bypass this. */
+/** Average delay between batched inventory broadcasts in seconds.
+ *  Blocks, InstantSend locks and whitelisted receivers bypass this. */
 static const unsigned int AVG_INVENTORY_BROADCAST_INTERVAL = 5;
+/** Maximum number of entries in a single outgoing inv message. */
+static const unsigned int MAX_INV_SEND_SZ = 1000;
 /** Block download timeout base, expressed in millionths of the block interval (i.e. 2.5 min) */
 static const int64_t BLOCK_DOWNLOAD_TIMEOUT_BASE = 250000;
 /** Additional block download timeout per parallel downloading peer (i.e. 1.25 min) */
@@ -313,6 +324,12 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nMaxBlocksInFlight;
+    uint64_t nBlocksReceived;
+    uint64_t nBlockBytesReceived;
+    int64_t nBlockTimeAvg;
+    uint64_t nBlockBytesPerSecond;
+    uint64_t nBlocksReRequested;
 };
 
 struct CTimestampIndexIteratorKey {
@@ -832,6 +849,9 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex *pindex);
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
+/** Serialized headers of chainActive, used to answer getheaders and getblocks. */
+extern CHeaderCache headercache;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
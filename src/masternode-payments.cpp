@@ -240,6 +240,14 @@ void CMasternodePayments::Clear()
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
     mapMasternodeBlocks.clear();
     mapMasternodePaymentVotes.clear();
+    cacheGeneration.Bump();
+}
+
+void CMasternodePayments::GetCacheSnapshot(cache_snapshot_t& snapshotRet) const
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+    snapshotRet.mapMasternodePaymentVotes = mapMasternodePaymentVotes;
+    snapshotRet.mapMasternodeBlocks = mapMasternodeBlocks;
 }
 
 bool CMasternodePayments::CanVote(COutPoint outMasternode, int nBlockHeight)
@@ -356,6 +364,7 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand,
             // but first mark vote as non-verified,
             // AddPaymentVote() below should take care of it if vote is actually ok
             mapMasternodePaymentVotes[nHash].MarkAsNotVerified();
+            cacheGeneration.Bump();
         }
 
         int nFirstBlock = pCurrentBlockIndex->nHeight - GetStorageLimit();
@@ -445,24 +454,20 @@ bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 
 // Is this masternode scheduled to get paid soon?
 // -- Only look ahead up to 8 blocks to allow for propagation of the latest 2 blocks of votes
-bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
+void CMasternodePayments::GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet)
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if(!pCurrentBlockIndex) return false;
-
-    CScript mnpayee;
-    mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
+    if(!pCurrentBlockIndex) return;
 
     CScript payee;
     for(int64_t h = pCurrentBlockIndex->nHeight; h <= pCurrentBlockIndex->nHeight + 8; h++){
         if(h == nNotBlockHeight) continue;
-        if(mapMasternodeBlocks.count(h) && mapMasternodeBlocks[h].GetBestPayee(payee) && mnpayee == payee) {
-            return true;
+        std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(h);
+        if(it != mapMasternodeBlocks.end() && it->second.GetBestPayee(payee)) {
+            setPayeesRet.insert(payee);
         }
     }
-
-    return false;
 }
 
 bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
@@ -482,6 +487,7 @@ bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
     }
 
     mapMasternodeBlocks[vote.nBlockHeight].AddPayee(vote);
+    cacheGeneration.Bump();
 
     return true;
 }
@@ -646,6 +652,7 @@ void CMasternodePayments::CheckAndRemove()
             LogPrint("mnpayments", "CMasternodePayments::CheckAndRemove -- Removing old Masternode payment: nBlockHeight=%d\n", vote.nBlockHeight);
             mapMasternodePaymentVotes.erase(it++);
             mapMasternodeBlocks.erase(vote.nBlockHeight);
+            cacheGeneration.Bump();
         } else {
             ++it;
         }
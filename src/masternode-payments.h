@@ -8,6 +8,7 @@
 
 #include "util.h"
 #include "core_io.h"
+#include "flat-database.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
@@ -176,7 +177,33 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
+    // bumped whenever the votes or blocks change, see GetCacheGeneration()
+    CFlatDBGeneration cacheGeneration;
+
+    /// The sections of mnpayments.dat, shared by loading them and writing them from a cache_snapshot_t
+    template <typename Stream, typename Operation, typename State>
+    static void SerializeCache(Stream& s, Operation ser_action, int nType, int nVersion, State& state, bool& fDamaged) {
+        // the blocks list the hashes of the votes, keep both or neither
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapMasternodePaymentVotes, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapMasternodeBlocks, fDamaged));
+    }
+
 public:
+    /// Copy of the votes and blocks, serialized without holding their locks
+    struct cache_snapshot_t
+    {
+        std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
+        std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+            bool fDamaged = false;
+            SerializeCache(s, ser_action, nType, nVersion, *this, fDamaged);
+        }
+    };
+
     std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
     std::map<COutPoint, int> mapMasternodesLastVote;
@@ -187,12 +214,29 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        READWRITE(mapMasternodePaymentVotes);
-        READWRITE(mapMasternodeBlocks);
+        if(!ser_action.ForRead()) {
+            // write a copy, so the votes and blocks are only locked while it is taken
+            cache_snapshot_t snapshot;
+            GetCacheSnapshot(snapshot);
+            READWRITE(snapshot);
+            return;
+        }
+
+        bool fDamaged = false;
+        SerializeCache(s, ser_action, nType, nVersion, *this, fDamaged);
+        if(fDamaged) {
+            Clear();
+        }
+        cacheGeneration.Bump();
     }
 
     void Clear();
 
+    /// Copy the votes and blocks written to mnpayments.dat
+    void GetCacheSnapshot(cache_snapshot_t& snapshotRet) const;
+    /// Changes whenever the votes or blocks do, doesn't take their locks
+    uint64_t GetCacheGeneration() const { return cacheGeneration.Get(); }
+
     bool AddPaymentVote(const CMasternodePaymentVote& vote);
     bool HasVerifiedPaymentVote(uint256 hashIn);
     bool ProcessBlock(int nBlockHeight);
@@ -203,7 +247,8 @@ public:
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
-    bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
+    /// Collect the payees currently winning the votes for the next blocks, except for nNotBlockHeight
+    void GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet);
 
     bool CanVote(COutPoint outMasternode, int nBlockHeight);
 
@@ -6,25 +6,21 @@
 #include "addrman.h"
 #include "darksend.h"
 #include "governance.h"
+#include "hash.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "netfulfilledman.h"
+#include "random.h"
 #include "util.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 /** Masternode manager */
 CMasternodeMan mnodeman;
 
-const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-4";
-
-struct CompareLastPaidBlock
-{
-    bool operator()(const std::pair<int, CMasternode*>& t1,
-                    const std::pair<int, CMasternode*>& t2) const
-    {
-        return (t1.first != t2.first) ? (t1.first < t2.first) : (t1.second->vin < t2.second->vin);
-    }
-};
+const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-5";
 
 struct CompareScoreMN
 {
@@ -78,34 +74,177 @@ void CMasternodeIndex::Clear()
     mapReverseIndex.clear();
     nSize = 0;
 }
-struct CompareByAddr
+void CMasternodeIndex::RebuildIndex()
+{
+    nSize = mapIndex.size();
+    for(index_m_it it = mapIndex.begin(); it != mapIndex.end(); ++it) {
+        mapReverseIndex[it->second] = it->first;
+    }
+}
+
+CMasternodeLastPaidIndex::CMasternodeLastPaidIndex(const CMasternodeLastPaidIndex& other)
+{
+    LOCK(other.cs);
+    hashBestBlock = other.hashBestBlock;
+    mapLastPaid = other.mapLastPaid;
+}
 
+CMasternodeLastPaidIndex& CMasternodeLastPaidIndex::operator=(const CMasternodeLastPaidIndex& other)
 {
-    bool operator()(const CMasternode* t1,
-                    const CMasternode* t2) const
+    if(this == &other) return *this;
+    uint256 hashBestBlockOther;
+    last_paid_m_t mapLastPaidOther;
     {
-        return t1->addr < t2->addr;
+        LOCK(other.cs);
+        hashBestBlockOther = other.hashBestBlock;
+        mapLastPaidOther = other.mapLastPaid;
     }
-};
+    LOCK(cs);
+    hashBestBlock = hashBestBlockOther;
+    mapLastPaid.swap(mapLastPaidOther);
+    return *this;
+}
 
-void CMasternodeIndex::RebuildIndex()
+bool CMasternodeLastPaidIndex::ApplyBlock(const CBlock& block, const CBlockIndex* pindex, bool fConnect)
 {
-    nSize = mapIndex.size();
-    for(index_m_it it = mapIndex.begin(); it != mapIndex.end(); ++it) {
-        mapReverseIndex[it->second] = it->first;
+    AssertLockHeld(cs);
+
+    if(block.vtx.empty()) return true;
+
+    bool fComplete = true;
+    // same rule as block validation uses to tell the masternode payment apart
+    CAmount nMasternodePayment = GetMasternodePayment(pindex->nHeight, block.vtx[0].GetValueOut());
+
+    BOOST_FOREACH(const CTxOut& txout, block.vtx[0].vout) {
+        if(txout.nValue != nMasternodePayment) continue;
+        if(fConnect) {
+            last_paid_t& lastPaid = mapLastPaid[CScriptID(txout.scriptPubKey)];
+            if(lastPaid.nBlockHeight == pindex->nHeight) continue;
+            lastPaid.nPrevBlockHeight = lastPaid.nBlockHeight;
+            lastPaid.nPrevTime = lastPaid.nTime;
+            lastPaid.nBlockHeight = pindex->nHeight;
+            lastPaid.nTime = pindex->nTime;
+        } else {
+            last_paid_m_it it = mapLastPaid.find(CScriptID(txout.scriptPubKey));
+            if(it == mapLastPaid.end() || it->second.nBlockHeight != pindex->nHeight) continue;
+            if(it->second.nPrevBlockHeight <= 0) {
+                // the payment before this one is unknown if we already stepped back once
+                if(it->second.nPrevBlockHeight < 0) fComplete = false;
+                mapLastPaid.erase(it);
+                continue;
+            }
+            it->second.nBlockHeight = it->second.nPrevBlockHeight;
+            it->second.nTime = it->second.nPrevTime;
+            it->second.nPrevBlockHeight = -1;
+            it->second.nPrevTime = 0;
+        }
+    }
+    return fComplete;
+}
+
+void CMasternodeLastPaidIndex::ConnectBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    // index is out of sync, leave it to Sync()
+    if(pindex->pprev ? hashBestBlock != pindex->pprev->GetBlockHash() : !hashBestBlock.IsNull()) return;
+
+    ApplyBlock(block, pindex, true);
+    hashBestBlock = pindex->GetBlockHash();
+}
+
+void CMasternodeLastPaidIndex::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    if(hashBestBlock != pindex->GetBlockHash()) return;
+
+    if(!ApplyBlock(block, pindex, false)) {
+        // a payee was paid more than once in the disconnected blocks, leave it to Sync()
+        LogPrint("masternode", "CMasternodeLastPaidIndex::DisconnectBlock -- can't step back over block %d, rescan needed\n", pindex->nHeight);
+        hashBestBlock.SetNull();
+        return;
+    }
+    hashBestBlock = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+}
+
+bool CMasternodeLastPaidIndex::Sync(int nScanBlocks)
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs);
+
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    if(!pindexTip || hashBestBlock == pindexTip->GetBlockHash()) return false;
+
+    int64_t nTimeStart = GetTimeMillis();
+    int nStartHeight = std::max(0, pindexTip->nHeight - nScanBlocks + 1);
+
+    mapLastPaid.clear();
+    for(const CBlockIndex* pindex = chainActive[nStartHeight]; pindex; pindex = chainActive.Next(pindex)) {
+        CBlock block;
+        if(!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) // shouldn't really happen
+            continue;
+        ApplyBlock(block, pindex, true);
+    }
+    hashBestBlock = pindexTip->GetBlockHash();
+
+    LogPrintf("CMasternodeLastPaidIndex::Sync -- rebuilt from %d blocks, %d payees, %dms\n",
+                pindexTip->nHeight - nStartHeight + 1, mapLastPaid.size(), GetTimeMillis() - nTimeStart);
+    return true;
+}
+
+bool CMasternodeLastPaidIndex::Get(const CScript& payee, int& nBlockHeightRet, int64_t& nTimeRet) const
+{
+    LOCK(cs);
+    last_paid_m_cit it = mapLastPaid.find(CScriptID(payee));
+    if(it == mapLastPaid.end()) return false;
+    nBlockHeightRet = it->second.nBlockHeight;
+    nTimeRet = it->second.nTime;
+    return true;
+}
+
+bool CMasternodeLastPaidIndex::CheckAndRemove(int nMinHeight)
+{
+    LOCK(cs);
+    bool fRemoved = false;
+    last_paid_m_it it = mapLastPaid.begin();
+    while(it != mapLastPaid.end()) {
+        if(it->second.nBlockHeight < nMinHeight) {
+            mapLastPaid.erase(it++);
+            fRemoved = true;
+        } else {
+            ++it;
+        }
     }
+    return fRemoved;
+}
+
+void CMasternodeLastPaidIndex::Clear()
+{
+    LOCK(cs);
+    hashBestBlock = uint256();
+    mapLastPaid.clear();
 }
 
 CMasternodeMan::CMasternodeMan()
 : cs(),
+  cs_snapshot(),
+  pListSnapshot(),
+  nListSnapshotTime(0),
   vMasternodes(),
+  mapRankCache(),
+  nRankCacheUseCount(0),
+  fListSnapshotDirty(true),
   mAskedUsForMasternodeList(),
   mWeAskedForMasternodeList(),
   mWeAskedForMasternodeListEntry(),
   mWeAskedForVerification(),
+  listScheduledVerifyRequests(),
+  mapVerifyRequestTime(),
+  verifyRound(),
   mMnbRecoveryRequests(),
   mMnbRecoveryGoodReplies(),
   listScheduledMnbRequestConnections(),
+  vecMnbPending(),
+  setMnbPendingHashes(),
   nLastIndexRebuildTime(0),
   indexMasternodes(),
   indexMasternodesOld(),
@@ -119,6 +258,94 @@ CMasternodeMan::CMasternodeMan()
   nDsqCount(0)
 {}
 
+CMasternodeMan::CLookupHasher::CLookupHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CMasternodeMan::CLookupHasher::operator()(const COutPoint& outpoint) const
+{
+    return SipHashUint256Extra(k0, k1, outpoint.hash, outpoint.n);
+}
+
+size_t CMasternodeMan::CLookupHasher::operator()(const CPubKey& pubKey) const
+{
+    return CSipHasher(k0, k1).Write(pubKey.begin(), pubKey.size()).Finalize();
+}
+
+size_t CMasternodeMan::CLookupHasher::operator()(const CScript& script) const
+{
+    return CSipHasher(k0, k1).Write(script.empty() ? NULL : &script[0], script.size()).Finalize();
+}
+
+size_t CMasternodeMan::CLookupHasher::operator()(const CService& addr) const
+{
+    std::vector<unsigned char> vchKey = addr.GetKey();
+    return CSipHasher(k0, k1).Write(&vchKey[0], vchKey.size()).Finalize();
+}
+
+// Position of the first masternode in vMasternodes with the given key, -1 if there is none
+template <typename Lookup, typename Key>
+static int LookupFirst(const Lookup& mapLookup, const Key& key)
+{
+    int nPos = -1;
+    std::pair<typename Lookup::const_iterator, typename Lookup::const_iterator> range = mapLookup.equal_range(key);
+    for(typename Lookup::const_iterator it = range.first; it != range.second; ++it) {
+        if(nPos == -1 || (int)it->second < nPos) nPos = it->second;
+    }
+    return nPos;
+}
+
+template <typename Lookup, typename Key>
+static void LookupErase(Lookup& mapLookup, const Key& key, size_t nPos)
+{
+    std::pair<typename Lookup::iterator, typename Lookup::iterator> range = mapLookup.equal_range(key);
+    for(typename Lookup::iterator it = range.first; it != range.second; ++it) {
+        if(it->second == nPos) {
+            mapLookup.erase(it);
+            return;
+        }
+    }
+}
+
+void CMasternodeMan::AddToLookup(size_t nPos)
+{
+    AssertLockHeld(cs);
+    const CMasternode& mn = vMasternodes[nPos];
+    mapLookupOutpoint[mn.vin.prevout] = nPos;
+    mapLookupPubKey.insert(std::make_pair(mn.pubKeyMasternode, nPos));
+    mapLookupPayee.insert(std::make_pair(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()), nPos));
+    mapLookupAddr.insert(std::make_pair(mn.addr, nPos));
+    setPaymentQueue.insert(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+}
+
+void CMasternodeMan::UpdateLookup(const CMasternode* pmn, const CPubKey& pubKeyMasternodeOld, const CService& addrOld)
+{
+    AssertLockHeld(cs);
+    size_t nPos = pmn - &vMasternodes[0];
+    if(pmn->pubKeyMasternode != pubKeyMasternodeOld) {
+        LookupErase(mapLookupPubKey, pubKeyMasternodeOld, nPos);
+        mapLookupPubKey.insert(std::make_pair(pmn->pubKeyMasternode, nPos));
+    }
+    if(pmn->addr != addrOld) {
+        LookupErase(mapLookupAddr, addrOld, nPos);
+        mapLookupAddr.insert(std::make_pair(pmn->addr, nPos));
+    }
+    // the update may have changed protocol version and state as well
+    ListChanged();
+}
+
+void CMasternodeMan::RebuildLookup()
+{
+    AssertLockHeld(cs);
+    mapLookupOutpoint.clear();
+    mapLookupPubKey.clear();
+    mapLookupPayee.clear();
+    mapLookupAddr.clear();
+    setPaymentQueue.clear();
+    for(size_t i = 0; i < vMasternodes.size(); i++) {
+        AddToLookup(i);
+    }
+    ListChanged();
+}
+
 bool CMasternodeMan::Add(CMasternode &mn)
 {
     LOCK(cs);
@@ -127,6 +354,8 @@ bool CMasternodeMan::Add(CMasternode &mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        AddToLookup(vMasternodes.size() - 1);
+        ListChanged();
         indexMasternodes.AddMasternodeVIN(mn.vin);
         fMasternodesAdded = true;
         return true;
@@ -160,6 +389,7 @@ void CMasternodeMan::AskForMN(CNode* pnode, const CTxIn &vin)
         LogPrintf("CMasternodeMan::AskForMN -- Asking peer %s for missing masternode entry for the first time: %s\n", pnode->addr.ToString(), vin.prevout.ToStringShort());
     }
     mWeAskedForMasternodeListEntry[vin.prevout][pnode->addr] = GetTime() + DSEG_UPDATE_SECONDS;
+    cacheGeneration.Bump();
 
     pnode->PushMessage(NetMsgType::DSEG, vin);
 }
@@ -170,9 +400,21 @@ void CMasternodeMan::Check()
 
     LogPrint("masternode", "CMasternodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
+    bool fStateChanged = false;
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        int nActiveStatePrev = mn.nActiveState;
         mn.Check();
+        fStateChanged |= mn.nActiveState != nActiveStatePrev;
     }
+    if(fStateChanged) ListChanged();
+
+    // batch all updates since the previous call into one new snapshot for readers
+    int64_t nTimeSinceSnapshot;
+    {
+        LOCK(cs_snapshot);
+        nTimeSinceSnapshot = GetTime() - nListSnapshotTime;
+    }
+    if(fListSnapshotDirty || nTimeSinceSnapshot >= LIST_SNAPSHOT_REFRESH_SECONDS) PublishListSnapshot();
 }
 
 void CMasternodeMan::CheckAndRemove()
@@ -189,6 +431,7 @@ void CMasternodeMan::CheckAndRemove()
         Check();
 
         // Remove spent masternodes, prepare structures and make requests to reasure the state of inactive ones
+        bool fRemoved = false;
         std::vector<CMasternode>::iterator it = vMasternodes.begin();
         std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES masternode entries at a time
@@ -208,6 +451,7 @@ void CMasternodeMan::CheckAndRemove()
                 it->FlagGovernanceItemsAsDirty();
                 it = vMasternodes.erase(it);
                 fMasternodesRemoved = true;
+                fRemoved = true;
             } else {
                 bool fAsk = pCurrentBlockIndex &&
                             (nAskForMnbRecovery > 0) &&
@@ -219,6 +463,11 @@ void CMasternodeMan::CheckAndRemove()
                     std::set<CNetAddr> setRequested;
                     // calulate only once and only when it's needed
                     if(vecMasternodeRanks.empty()) {
+                        // ranks are looked up by position, bring lookups up to date with removals so far
+                        if(fRemoved) {
+                            RebuildLookup();
+                            fRemoved = false;
+                        }
                         int nRandomBlockHeight = GetRandInt(pCurrentBlockIndex->nHeight);
                         vecMasternodeRanks = GetMasternodeRanks(nRandomBlockHeight);
                     }
@@ -239,11 +488,17 @@ void CMasternodeMan::CheckAndRemove()
                     }
                     // wait for mnb recovery replies for MNB_RECOVERY_WAIT_SECONDS seconds
                     mMnbRecoveryRequests[hash] = std::make_pair(GetTime() + MNB_RECOVERY_WAIT_SECONDS, setRequested);
+                    cacheGeneration.Bump();
                 }
                 ++it;
             }
         }
 
+        // positions have shifted, update lookups before anything below tries to find a masternode
+        if(fRemoved) {
+            RebuildLookup();
+        }
+
         // proces replies for MASTERNODE_NEW_START_REQUIRED masternodes
         LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- mMnbRecoveryGoodReplies size=%d\n", (int)mMnbRecoveryGoodReplies.size());
         std::map<uint256, std::vector<CMasternodeBroadcast> >::iterator itMnbReplies = mMnbRecoveryGoodReplies.begin();
@@ -260,6 +515,7 @@ void CMasternodeMan::CheckAndRemove()
                 }
                 LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- removing mnb recovery reply, masternode=%s, size=%d\n", itMnbReplies->second[0].vin.prevout.ToStringShort(), (int)itMnbReplies->second.size());
                 mMnbRecoveryGoodReplies.erase(itMnbReplies++);
+                cacheGeneration.Bump();
             } else {
                 ++itMnbReplies;
             }
@@ -269,12 +525,16 @@ void CMasternodeMan::CheckAndRemove()
         // no need for cm_main below
         LOCK(cs);
 
+        // only bump the cache generation if something written to mncache.dat expired
+        bool fCacheChanged = false;
+
         std::map<uint256, std::pair< int64_t, std::set<CNetAddr> > >::iterator itMnbRequest = mMnbRecoveryRequests.begin();
         while(itMnbRequest != mMnbRecoveryRequests.end()){
             // Allow this mnb to be re-verified again after MNB_RECOVERY_RETRY_SECONDS seconds
             // if mn is still in MASTERNODE_NEW_START_REQUIRED state.
             if(GetTime() - itMnbRequest->second.first > MNB_RECOVERY_RETRY_SECONDS) {
                 mMnbRecoveryRequests.erase(itMnbRequest++);
+                fCacheChanged = true;
             } else {
                 ++itMnbRequest;
             }
@@ -285,6 +545,7 @@ void CMasternodeMan::CheckAndRemove()
         while(it1 != mAskedUsForMasternodeList.end()){
             if((*it1).second < GetTime()) {
                 mAskedUsForMasternodeList.erase(it1++);
+                fCacheChanged = true;
             } else {
                 ++it1;
             }
@@ -295,6 +556,7 @@ void CMasternodeMan::CheckAndRemove()
         while(it1 != mWeAskedForMasternodeList.end()){
             if((*it1).second < GetTime()){
                 mWeAskedForMasternodeList.erase(it1++);
+                fCacheChanged = true;
             } else {
                 ++it1;
             }
@@ -307,6 +569,7 @@ void CMasternodeMan::CheckAndRemove()
             while(it3 != it2->second.end()){
                 if(it3->second < GetTime()){
                     it2->second.erase(it3++);
+                    fCacheChanged = true;
                 } else {
                     ++it3;
                 }
@@ -335,6 +598,7 @@ void CMasternodeMan::CheckAndRemove()
             if((*it4).second.IsExpired()) {
                 LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing expired Masternode ping: hash=%s\n", (*it4).second.GetHash().ToString());
                 mapSeenMasternodePing.erase(it4++);
+                fCacheChanged = true;
             } else {
                 ++it4;
             }
@@ -351,6 +615,14 @@ void CMasternodeMan::CheckAndRemove()
             }
         }
 
+        // forget payees that weren't paid within the payments storage window
+        if(lastPaidIndex.CheckAndRemove(pCurrentBlockIndex->nHeight - mnpayments.GetStorageLimit())) {
+            fCacheChanged = true;
+        }
+        if(fCacheChanged) {
+            cacheGeneration.Bump();
+        }
+
         LogPrintf("CMasternodeMan::CheckAndRemove -- %s\n", ToString());
 
         if(fMasternodesRemoved) {
@@ -367,6 +639,12 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    mapLookupOutpoint.clear();
+    mapLookupPubKey.clear();
+    mapLookupPayee.clear();
+    mapLookupAddr.clear();
+    setPaymentQueue.clear();
+    ListChanged();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -376,6 +654,24 @@ void CMasternodeMan::Clear()
     nLastWatchdogVoteTime = 0;
     indexMasternodes.Clear();
     indexMasternodesOld.Clear();
+    lastPaidIndex.Clear();
+}
+
+void CMasternodeMan::GetCacheSnapshot(cache_snapshot_t& snapshotRet) const
+{
+    LOCK(cs);
+    snapshotRet.vMasternodes = vMasternodes;
+    snapshotRet.mAskedUsForMasternodeList = mAskedUsForMasternodeList;
+    snapshotRet.mWeAskedForMasternodeList = mWeAskedForMasternodeList;
+    snapshotRet.mWeAskedForMasternodeListEntry = mWeAskedForMasternodeListEntry;
+    snapshotRet.mMnbRecoveryRequests = mMnbRecoveryRequests;
+    snapshotRet.mMnbRecoveryGoodReplies = mMnbRecoveryGoodReplies;
+    snapshotRet.nLastWatchdogVoteTime = nLastWatchdogVoteTime;
+    snapshotRet.nDsqCount = nDsqCount;
+    snapshotRet.mapSeenMasternodeBroadcast = mapSeenMasternodeBroadcast;
+    snapshotRet.mapSeenMasternodePing = mapSeenMasternodePing;
+    snapshotRet.indexMasternodes = indexMasternodes;
+    snapshotRet.lastPaidIndex = lastPaidIndex;
 }
 
 int CMasternodeMan::CountMasternodes(int nProtocolVersion)
@@ -437,47 +733,122 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
         }
     }
     
-    pnode->PushMessage(NetMsgType::DSEG, CTxIn());
+    if(pnode->nVersion >= MNLIST_DIGEST_VERSION) {
+        // send what we have, so that only the entries we are missing or have outdated come back
+        std::vector<uint256> vecAnnounceDigests;
+        std::vector<uint256> vecPingDigests;
+        GetListDigests(vecAnnounceDigests, vecPingDigests);
+        pnode->PushMessage(NetMsgType::MNLISTDIGEST, vecAnnounceDigests, vecPingDigests);
+    } else {
+        pnode->PushMessage(NetMsgType::DSEG, CTxIn());
+    }
     int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
+    cacheGeneration.Bump();
 
     LogPrint("masternode", "CMasternodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
+bool CMasternodeMan::CheckListRequest(CNode* pfrom)
+{
+    AssertLockHeld(cs);
+
+    //local network
+    bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
+
+    if(!isLocal && Params().NetworkIDString() == CBaseChainParams::MAIN) {
+        std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
+        if (i != mAskedUsForMasternodeList.end()){
+            int64_t t = (*i).second;
+            if (GetTime() < t) {
+                Misbehaving(pfrom->GetId(), 34);
+                LogPrintf("CMasternodeMan::CheckListRequest -- peer already asked me for the list, peer=%d\n", pfrom->id);
+                return false;
+            }
+        }
+        int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
+        mAskedUsForMasternodeList[pfrom->addr] = askAgain;
+        cacheGeneration.Bump();
+    }
+    return true;
+}
+
+bool CMasternodeMan::IsSentToPeers(CMasternode& mn)
+{
+    if (mn.addr.IsRFC1918() || mn.addr.IsLocal()) return false; // do not send local network masternode
+    if (mn.IsUpdateRequired()) return false; // do not send outdated masternodes
+    return true;
+}
+
+size_t CMasternodeMan::GetListDigestBucket(const COutPoint& outpoint)
+{
+    return (outpoint.hash.GetCheapHash() + outpoint.n) % MNLIST_DIGEST_BUCKETS;
+}
+
+void CMasternodeMan::GetListDigests(std::vector<uint256>& vecAnnounceDigestsRet, std::vector<uint256>& vecPingDigestsRet)
+{
+    AssertLockHeld(cs);
+
+    // XOR doesn't depend on the order of vMasternodes, which differs between peers
+    vecAnnounceDigestsRet.assign(MNLIST_DIGEST_BUCKETS, uint256());
+    vecPingDigestsRet.assign(MNLIST_DIGEST_BUCKETS, uint256());
+
+    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        if(!IsSentToPeers(mn)) continue;
+
+        size_t nBucket = GetListDigestBucket(mn.vin.prevout);
+
+        CHashWriter ssAnnounce(SER_GETHASH, PROTOCOL_VERSION);
+        ssAnnounce << mn.vin.prevout << CMasternodeBroadcast(mn).GetHash();
+        uint256 hashAnnounce = ssAnnounce.GetHash();
+
+        CHashWriter ssPing(SER_GETHASH, PROTOCOL_VERSION);
+        ssPing << mn.vin.prevout << mn.lastPing.GetHash();
+        uint256 hashPing = ssPing.GetHash();
+
+        for(unsigned int i = 0; i < hashAnnounce.size(); i++) {
+            *(vecAnnounceDigestsRet[nBucket].begin() + i) ^= *(hashAnnounce.begin() + i);
+            *(vecPingDigestsRet[nBucket].begin() + i) ^= *(hashPing.begin() + i);
+        }
+    }
+}
+
+void CMasternodeMan::PushListEntry(CNode* pnode, const CMasternode& mn, bool fAnnounce, bool fPing)
+{
+    AssertLockHeld(cs);
+
+    CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
+    uint256 hash = mnb.GetHash();
+    if (fAnnounce) pnode->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+    if (fPing) pnode->PushInventory(CInv(MSG_MASTERNODE_PING, mn.lastPing.GetHash()));
+
+    if (!mapSeenMasternodeBroadcast.count(hash)) {
+        mapSeenMasternodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), mnb)));
+    }
+}
+
 CMasternode* CMasternodeMan::Find(const CScript &payee)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
-            return &mn;
-    }
-    return NULL;
+    int nPos = LookupFirst(mapLookupPayee, payee);
+    return nPos == -1 ? NULL : &vMasternodes[nPos];
 }
 
 CMasternode* CMasternodeMan::Find(const CTxIn &vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    lookup_outpoint_m_t::const_iterator it = mapLookupOutpoint.find(vin.prevout);
+    return it == mapLookupOutpoint.end() ? NULL : &vMasternodes[it->second];
 }
 
 CMasternode* CMasternodeMan::Find(const CPubKey &pubKeyMasternode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.pubKeyMasternode == pubKeyMasternode)
-            return &mn;
-    }
-    return NULL;
+    int nPos = LookupFirst(mapLookupPubKey, pubKeyMasternode);
+    return nPos == -1 ? NULL : &vMasternodes[nPos];
 }
 
 bool CMasternodeMan::Get(const CPubKey& pubKeyMasternode, CMasternode& masternode)
@@ -553,22 +924,44 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     LOCK2(cs_main,cs);
 
     CMasternode *pBestMasternode = NULL;
-    std::vector<std::pair<int, CMasternode*> > vecMasternodeLastPaid;
+
+    int nMnCount = CountEnabled();
+    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
+    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
+    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
+    //  -- (chance per block * chances before the scheduled payees below are skipped)
+    int nTenthNetwork = std::max(nMnCount/10, 1);
+
+    // it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
+    std::vector<bool> vecScheduled(vMasternodes.size(), false);
+    std::set<CScript> setScheduledPayees;
+    mnpayments.GetScheduledPayees(nBlockHeight, setScheduledPayees);
+    BOOST_FOREACH(const CScript& payee, setScheduledPayees) {
+        std::pair<lookup_payee_m_t::const_iterator, lookup_payee_m_t::const_iterator> range = mapLookupPayee.equal_range(payee);
+        for(lookup_payee_m_t::const_iterator it = range.first; it != range.second; ++it) {
+            vecScheduled[it->second] = true;
+        }
+    }
 
     /*
-        Make a vector with all of the last paid times
+        Walk the payment queue from the oldest payment on, counting all eligible
+        masternodes and keeping the first tenth of them for scoring
     */
 
-    int nMnCount = CountEnabled();
-    BOOST_FOREACH(CMasternode &mn, vMasternodes)
+    std::vector<CMasternode*> vecOldest;
+    nCount = 0;
+    BOOST_FOREACH(const PAIRTYPE(int, COutPoint)& entry, setPaymentQueue)
     {
+        lookup_outpoint_m_t::const_iterator itPos = mapLookupOutpoint.find(entry.second);
+        if(itPos == mapLookupOutpoint.end()) continue;
+        CMasternode &mn = vMasternodes[itPos->second];
+
         if(!mn.IsValidForPayment()) continue;
 
         // //check protocol version
         if(mn.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
 
-        //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if(mnpayments.IsScheduled(mn, nBlockHeight)) continue;
+        if(vecScheduled[itPos->second]) continue;
 
         //it's too new, wait for a cycle
         if(fFilterSigTime && mn.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
@@ -576,17 +969,13 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
         //make sure it has at least as many confirmations as there are masternodes
         if(mn.GetCollateralAge() < nMnCount) continue;
 
-        vecMasternodeLastPaid.push_back(std::make_pair(mn.GetLastPaidBlock(), &mn));
+        if((int)vecOldest.size() < nTenthNetwork) vecOldest.push_back(&mn);
+        nCount++;
     }
 
-    nCount = (int)vecMasternodeLastPaid.size();
-
     //when the network is in the process of upgrading, don't penalize nodes that recently restarted
     if(fFilterSigTime && nCount < nMnCount/3) return GetNextMasternodeInQueueForPayment(nBlockHeight, false, nCount);
 
-    // Sort them low to high
-    sort(vecMasternodeLastPaid.begin(), vecMasternodeLastPaid.end(), CompareLastPaidBlock());
-
     uint256 blockHash;
 
       if(!GetBlockHash(blockHash, nBlockHeight - 101)) {
@@ -594,21 +983,13 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
         return NULL;
     }
 
-    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
-    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
-    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
-    //  -- (chance per block * chances before IsScheduled will fire)
-    int nTenthNetwork = nMnCount/10;
-    int nCountTenth = 0;
     arith_uint256 nHighest = 0;
-    BOOST_FOREACH (PAIRTYPE(int, CMasternode*)& s, vecMasternodeLastPaid){
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
+    BOOST_FOREACH(CMasternode* pmn, vecOldest) {
+        arith_uint256 nScore = pmn->CalculateScore(blockHash);
         if(nScore > nHighest){
             nHighest = nScore;
-            pBestMasternode = s.second;
+            pBestMasternode = pmn;
         }
-        nCountTenth++;
-        if(nCountTenth >= nTenthNetwork) break;
     }
     return pBestMasternode;
 }
@@ -656,68 +1037,145 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToE
     return NULL;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+static void CalculateScores(const std::vector<CMasternode*>& vpMasternodes, const uint256& blockHash,
+                            std::vector<std::pair<int64_t, CMasternode*> >& vecMasternodeScores, size_t nBegin, size_t nEnd)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
+    for(size_t i = nBegin; i < nEnd; i++) {
+        vecMasternodeScores[i] = std::make_pair((int64_t)vpMasternodes[i]->CalculateScore(blockHash).GetCompact(false), vpMasternodes[i]);
+    }
+}
 
-    //make sure we know about this block
-    uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
+const CMasternodeMan::rank_table_t& CMasternodeMan::GetRankTable(const uint256& blockHash, int nMinProtocol, rank_filter_t filter)
+{
+    AssertLockHeld(cs);
 
-    LOCK(cs);
+    rank_key_t key = std::make_pair(blockHash, std::make_pair(nMinProtocol, (int)filter));
+    rank_m_it it = mapRankCache.find(key);
+    if(it != mapRankCache.end()) {
+        it->second.nLastUsed = ++nRankCacheUseCount;
+        return it->second;
+    }
 
-    // scan for winner
+    std::vector<CMasternode*> vpMasternodes;
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
         if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive) {
-            if(!mn.IsEnabled()) continue;
-        }
-        else {
-            if(!mn.IsValidForPayment()) continue;
+        if(filter == RANK_FILTER_ENABLED && !mn.IsEnabled()) continue;
+        if(filter == RANK_FILTER_VALID_FOR_PAYMENT && !mn.IsValidForPayment()) continue;
+        vpMasternodes.push_back(&mn);
+    }
+
+    // scores don't depend on each other, so calculate them on all cores for big lists
+    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores(vpMasternodes.size());
+    size_t nThreads = std::min((size_t)std::max(GetNumCores(), 1), vpMasternodes.size() / MIN_RANK_THREAD_SCORES);
+    if(nThreads > 1) {
+        size_t nChunkSize = (vpMasternodes.size() + nThreads - 1) / nThreads;
+        boost::thread_group threadGroup;
+        for(size_t nBegin = 0; nBegin < vpMasternodes.size(); nBegin += nChunkSize) {
+            size_t nEnd = std::min(nBegin + nChunkSize, vpMasternodes.size());
+            threadGroup.create_thread(boost::bind(&CalculateScores, boost::cref(vpMasternodes), boost::cref(blockHash),
+                                                  boost::ref(vecMasternodeScores), nBegin, nEnd));
         }
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
+        threadGroup.join_all();
+    } else {
+        CalculateScores(vpMasternodes, blockHash, vecMasternodeScores, 0, vpMasternodes.size());
     }
 
     sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
 
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& scorePair, vecMasternodeScores) {
-        nRank++;
-        if(scorePair.second->vin.prevout == vin.prevout) return nRank;
+    if(mapRankCache.size() >= MAX_RANK_CACHE_SIZE) {
+        // drop the least recently used table
+        rank_m_it itOldest = mapRankCache.begin();
+        for(it = mapRankCache.begin(); it != mapRankCache.end(); ++it) {
+            if(it->second.nLastUsed < itOldest->second.nLastUsed) itOldest = it;
+        }
+        mapRankCache.erase(itOldest);
+    }
+
+    rank_table_t& table = mapRankCache[key];
+    table.nLastUsed = ++nRankCacheUseCount;
+    table.vecRanked.reserve(vecMasternodeScores.size());
+    table.mapRank.rehash(vecMasternodeScores.size());
+    BOOST_FOREACH(PAIRTYPE(int64_t, CMasternode*)& scorePair, vecMasternodeScores) {
+        table.vecRanked.push_back(scorePair.second->vin.prevout);
+        table.mapRank[scorePair.second->vin.prevout] = table.vecRanked.size();
     }
 
-    return -1;
+    LogPrint("masternode", "CMasternodeMan::GetRankTable -- ranked %d masternodes for block %s, nMinProtocol=%d, filter=%d\n",
+                table.vecRanked.size(), blockHash.ToString(), nMinProtocol, filter);
+
+    return table;
 }
 
-std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int nBlockHeight, int nMinProtocol)
+void CMasternodeMan::ListChanged()
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
-    std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
+    AssertLockHeld(cs);
+    mapRankCache.clear();
+    fListSnapshotDirty = true;
+    cacheGeneration.Bump();
+}
+
+void CMasternodeMan::PublishListSnapshot()
+{
+    AssertLockHeld(cs);
+
+    // copy outside of cs_snapshot, readers only wait for the pointer swap
+    list_snapshot_t pSnapshot(new std::vector<CMasternode>(vMasternodes));
+    fListSnapshotDirty = false;
+
+    LOCK(cs_snapshot);
+    pListSnapshot = pSnapshot;
+    nListSnapshotTime = GetTime();
+}
 
+CMasternodeMan::list_snapshot_t CMasternodeMan::GetListSnapshot()
+{
+    {
+        LOCK(cs_snapshot);
+        if(pListSnapshot && GetTime() - nListSnapshotTime < LIST_SNAPSHOT_MAX_AGE_SECONDS) return pListSnapshot;
+    }
+
+    // nothing recent was published, Check() doesn't run before the blockchain is synced
+    LOCK(cs);
+    PublishListSnapshot();
+    {
+        LOCK(cs_snapshot);
+        return pListSnapshot;
+    }
+}
+
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+{
     //make sure we know about this block
     uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return vecMasternodeRanks;
+    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    const rank_table_t& table = GetRankTable(blockHash, nMinProtocol, fOnlyActive ? RANK_FILTER_ENABLED : RANK_FILTER_VALID_FOR_PAYMENT);
 
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
+    boost::unordered_map<COutPoint, int, CLookupHasher>::const_iterator it = table.mapRank.find(vin.prevout);
+    if(it == table.mapRank.end()) return -1;
 
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+    return it->second;
+}
 
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
+std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int nBlockHeight, int nMinProtocol)
+{
+    std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
+    //make sure we know about this block
+    uint256 blockHash = uint256();
+    if(!GetBlockHash(blockHash, nBlockHeight)) return vecMasternodeRanks;
 
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores) {
-        nRank++;
-        vecMasternodeRanks.push_back(std::make_pair(nRank, *s.second));
+    LOCK(cs);
+
+    const rank_table_t& table = GetRankTable(blockHash, nMinProtocol, RANK_FILTER_ENABLED);
+
+    vecMasternodeRanks.reserve(table.vecRanked.size());
+    for(size_t i = 0; i < table.vecRanked.size(); i++) {
+        lookup_outpoint_m_t::const_iterator itPos = mapLookupOutpoint.find(table.vecRanked[i]);
+        if(itPos == mapLookupOutpoint.end()) continue;
+        vecMasternodeRanks.push_back(std::make_pair(i + 1, vMasternodes[itPos->second]));
     }
 
     return vecMasternodeRanks;
@@ -725,8 +1183,6 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
-
     LOCK(cs);
 
     uint256 blockHash;
@@ -735,28 +1191,11 @@ CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int nBlockHeight, in
         return NULL;
     }
 
-    // Fill scores
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    const rank_table_t& table = GetRankTable(blockHash, nMinProtocol, fOnlyActive ? RANK_FILTER_ENABLED : RANK_FILTER_NONE);
 
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive && !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
+    if(nRank < 1 || nRank > (int)table.vecRanked.size()) return NULL;
 
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores){
-        rank++;
-        if(rank == nRank) {
-            return s.second;
-        }
-    }
-
-    return NULL;
+    return Find(CTxIn(table.vecRanked[nRank - 1]));
 }
 
 void CMasternodeMan::ProcessMasternodeConnections()
@@ -812,10 +1251,30 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         CMasternodeBroadcast mnb;
         vRecv >> mnb;
 
-        pfrom->setAskFor.erase(mnb.GetHash());
+        uint256 hash = mnb.GetHash();
+
+        pfrom->setAskFor.erase(hash);
 
         LogPrint("masternode", "MNANNOUNCE -- Masternode announce, masternode=%s\n", mnb.vin.prevout.ToStringShort());
 
+        if(!masternodeSync.IsMasternodeListSynced()) {
+            // we are getting the whole list, queue new announces to verify their signatures in batches
+            bool fQueued = false;
+            bool fBatchFull = false;
+            {
+                LOCK(cs);
+                if(setMnbPendingHashes.count(hash)) return;
+                if(!mapSeenMasternodeBroadcast.count(hash)) {
+                    vecMnbPending.push_back(std::make_pair(pfrom->AddRef(), mnb));
+                    setMnbPendingHashes.insert(hash);
+                    fQueued = true;
+                    fBatchFull = vecMnbPending.size() >= MNB_BATCH_SIZE;
+                }
+            }
+            if(fBatchFull) ProcessPendingMnb();
+            if(fQueued) return;
+        }
+
         int nDos = 0;
 
         if (CheckMnbAndUpdateMasternodeList(pfrom, mnb, nDos)) {
@@ -844,6 +1303,8 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         if(mapSeenMasternodePing.count(nHash)) return; //seen
         mapSeenMasternodePing.insert(std::make_pair(nHash, mnp));
+        // the ping is also applied to the masternode and its seen announce below
+        cacheGeneration.Bump();
 
         LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s new\n", mnp.vin.prevout.ToStringShort());
 
@@ -854,7 +1315,10 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         if(pmn && pmn->IsNewStartRequired()) return;
 
         int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos)) return;
+        int nActiveStatePrev = pmn ? pmn->nActiveState : CMasternode::MASTERNODE_ENABLED;
+        bool fUpdated = mnp.CheckAndUpdate(pmn, false, nDos);
+        if(pmn && pmn->nActiveState != nActiveStatePrev) ListChanged();
+        if(fUpdated) return;
 
         if(nDos > 0) {
             // if anything significant failed, mark that node
@@ -882,42 +1346,19 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         LOCK(cs);
 
         if(vin == CTxIn()) { //only should ask for this once
-            //local network
-            bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
-
-            if(!isLocal && Params().NetworkIDString() == CBaseChainParams::MAIN) {
-                std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
-                if (i != mAskedUsForMasternodeList.end()){
-                    int64_t t = (*i).second;
-                    if (GetTime() < t) {
-                        Misbehaving(pfrom->GetId(), 34);
-                        LogPrintf("DSEG -- peer already asked me for the list, peer=%d\n", pfrom->id);
-                        return;
-                    }
-                }
-                int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
-                mAskedUsForMasternodeList[pfrom->addr] = askAgain;
-            }
+            if(!CheckListRequest(pfrom)) return;
         } //else, asking for a specific node which is ok
 
         int nInvCount = 0;
 
         BOOST_FOREACH(CMasternode& mn, vMasternodes) {
             if (vin != CTxIn() && vin != mn.vin) continue; // asked for specific vin but we are not there yet
-            if (mn.addr.IsRFC1918() || mn.addr.IsLocal()) continue; // do not send local network masternode
-            if (mn.IsUpdateRequired()) continue; // do not send outdated masternodes
+            if (!IsSentToPeers(mn)) continue;
 
             LogPrint("masternode", "DSEG -- Sending Masternode entry: masternode=%s  addr=%s\n", mn.vin.prevout.ToStringShort(), mn.addr.ToString());
-            CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
-            uint256 hash = mnb.GetHash();
-            pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
-            pfrom->PushInventory(CInv(MSG_MASTERNODE_PING, mn.lastPing.GetHash()));
+            PushListEntry(pfrom, mn, true, true);
             nInvCount++;
 
-            if (!mapSeenMasternodeBroadcast.count(hash)) {
-                mapSeenMasternodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), mnb)));
-            }
-
             if (vin == mn.vin) {
                 LogPrintf("DSEG -- Sent 1 Masternode inv to peer %d\n", pfrom->id);
                 return;
@@ -932,6 +1373,52 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         // smth weird happen - someone asked us for vin we have no idea about?
         LogPrint("masternode", "DSEG -- No invs sent to peer %d\n", pfrom->id);
 
+    } else if (strCommand == NetMsgType::MNLISTDIGEST) { // Get the parts of the Masternode list that differ
+        // Same as the full list request above
+        if (!masternodeSync.IsSynced()) return;
+
+        std::vector<uint256> vecAnnounceDigestsPeer;
+        std::vector<uint256> vecPingDigestsPeer;
+        vRecv >> vecAnnounceDigestsPeer >> vecPingDigestsPeer;
+
+        if(vecAnnounceDigestsPeer.size() != MNLIST_DIGEST_BUCKETS || vecPingDigestsPeer.size() != MNLIST_DIGEST_BUCKETS) {
+            LogPrintf("MNLISTDIGEST -- invalid number of buckets, peer=%d\n", pfrom->id);
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        LOCK(cs);
+
+        if(!CheckListRequest(pfrom)) return;
+
+        std::vector<uint256> vecAnnounceDigests;
+        std::vector<uint256> vecPingDigests;
+        GetListDigests(vecAnnounceDigests, vecPingDigests);
+
+        int nBucketsDiffer = 0;
+        for(size_t i = 0; i < MNLIST_DIGEST_BUCKETS; i++) {
+            if(vecAnnounceDigests[i] != vecAnnounceDigestsPeer[i] || vecPingDigests[i] != vecPingDigestsPeer[i]) nBucketsDiffer++;
+        }
+
+        int nInvCount = 0;
+
+        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+            if (!IsSentToPeers(mn)) continue;
+
+            size_t nBucket = GetListDigestBucket(mn.vin.prevout);
+            bool fAnnounce = vecAnnounceDigests[nBucket] != vecAnnounceDigestsPeer[nBucket];
+            bool fPing = vecPingDigests[nBucket] != vecPingDigestsPeer[nBucket];
+            if (!fAnnounce && !fPing) continue;
+
+            LogPrint("masternode", "MNLISTDIGEST -- Sending Masternode entry: masternode=%s  addr=%s\n", mn.vin.prevout.ToStringShort(), mn.addr.ToString());
+            PushListEntry(pfrom, mn, fAnnounce, fPing);
+            nInvCount++;
+        }
+
+        pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_LIST, nInvCount);
+        LogPrintf("MNLISTDIGEST -- Sent %d Masternode invs from %d/%d differing buckets to peer %d\n",
+                    nInvCount, nBucketsDiffer, (int)MNLIST_DIGEST_BUCKETS, pfrom->id);
+
     } else if (strCommand == NetMsgType::MNVERIFY) { // Masternode Verify
 
         // Need LOCK2 here to ensure consistent locking order because the all functions below call GetBlockHash which locks cs_main
@@ -950,6 +1437,8 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             // CASE 3: we _probably_ got verification broadcast signed by some masternode which verified another one
             ProcessVerifyBroadcast(pfrom, mnv);
         }
+        // PoSe ban scores might have changed
+        cacheGeneration.Bump();
     }
 }
 
@@ -960,14 +1449,9 @@ void CMasternodeMan::DoFullVerificationStep()
     if(activeMasternode.vin == CTxIn()) return;
     if(!masternodeSync.IsSynced()) return;
 
+    // rankings are cached, nothing below needs cs_main
     std::vector<std::pair<int, CMasternode> > vecMasternodeRanks = GetMasternodeRanks(pCurrentBlockIndex->nHeight - 1, MIN_POSE_PROTO_VERSION);
 
-    // Need LOCK2 here to ensure consistent locking order because the SendVerifyRequest call below locks cs_main
-    // through GetHeight() signal in ConnectNode
-    LOCK2(cs_main, cs);
-
-    int nCount = 0;
-
     int nMyRank = -1;
     int nRanksTotal = (int)vecMasternodeRanks.size();
 
@@ -991,43 +1475,56 @@ void CMasternodeMan::DoFullVerificationStep()
     // edge case: list is too short and this masternode is not enabled
     if(nMyRank == -1) return;
 
-    // send verify requests to up to MAX_POSE_CONNECTIONS masternodes
+    // pick up to MAX_POSE_CONNECTIONS masternodes
     // starting from MAX_POSE_RANK + nMyRank and using MAX_POSE_CONNECTIONS as a step
-    int nOffset = MAX_POSE_RANK + nMyRank - 1;
-    if(nOffset >= (int)vecMasternodeRanks.size()) return;
-
-    std::vector<CMasternode*> vSortedByAddr;
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        vSortedByAddr.push_back(&mn);
-    }
-
-    sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
-    it = vecMasternodeRanks.begin() + nOffset;
-    while(it != vecMasternodeRanks.end()) {
-        if(it->second.IsPoSeVerified() || it->second.IsPoSeBanned()) {
+    std::vector<CAddress> vecToVerify;
+    for(size_t nOffset = MAX_POSE_RANK + nMyRank - 1; nOffset < vecMasternodeRanks.size(); nOffset += MAX_POSE_CONNECTIONS) {
+        std::pair<int, CMasternode>& rank = vecMasternodeRanks[nOffset];
+        if(rank.second.IsPoSeVerified() || rank.second.IsPoSeBanned()) {
             LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- Already %s%s%s masternode %s address %s, skipping...\n",
-                        it->second.IsPoSeVerified() ? "verified" : "",
-                        it->second.IsPoSeVerified() && it->second.IsPoSeBanned() ? " and " : "",
-                        it->second.IsPoSeBanned() ? "banned" : "",
-                        it->second.vin.prevout.ToStringShort(), it->second.addr.ToString());
-            nOffset += MAX_POSE_CONNECTIONS;
-            if(nOffset >= (int)vecMasternodeRanks.size()) break;
-            it += MAX_POSE_CONNECTIONS;
+                        rank.second.IsPoSeVerified() ? "verified" : "",
+                        rank.second.IsPoSeVerified() && rank.second.IsPoSeBanned() ? " and " : "",
+                        rank.second.IsPoSeBanned() ? "banned" : "",
+                        rank.second.vin.prevout.ToStringShort(), rank.second.addr.ToString());
             continue;
         }
-        LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- Verifying masternode %s rank %d/%d address %s\n",
-                    it->second.vin.prevout.ToStringShort(), it->first, nRanksTotal, it->second.addr.ToString());
-        if(SendVerifyRequest((CAddress)it->second.addr, vSortedByAddr)) {
-            nCount++;
-            if(nCount >= MAX_POSE_CONNECTIONS) break;
+        if(netfulfilledman.HasFulfilledRequest(CAddress(rank.second.addr), strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
+            // we already asked for verification, not a good idea to do this too often, skip it
+            LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- too many requests, skipping... addr=%s\n", rank.second.addr.ToString());
+            continue;
         }
-        nOffset += MAX_POSE_CONNECTIONS;
-        if(nOffset >= (int)vecMasternodeRanks.size()) break;
-        it += MAX_POSE_CONNECTIONS;
+        LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- Verifying masternode %s rank %d/%d address %s\n",
+                    rank.second.vin.prevout.ToStringShort(), rank.first, nRanksTotal, rank.second.addr.ToString());
+        vecToVerify.push_back(CAddress(rank.second.addr));
+        if((int)vecToVerify.size() >= MAX_POSE_CONNECTIONS) break;
+    }
+
+    LOCK(cs);
+
+    if(verifyRound.nScheduled > 0) {
+        LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- Previous round: scheduled %d, sent %d, replies %d, reply time avg %dms max %dms\n",
+                    verifyRound.nScheduled, verifyRound.nSent, verifyRound.nReplies,
+                    verifyRound.nReplies ? verifyRound.nReplyMillisTotal / verifyRound.nReplies : 0, verifyRound.nReplyMillisMax);
     }
 
-    LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- Sent verification requests to %d masternodes\n", nCount);
+    // requests of the previous round that weren't sent yet are outdated now
+    listScheduledVerifyRequests.assign(vecToVerify.begin(), vecToVerify.end());
+    mapVerifyRequestTime.clear();
+    verifyRound = verify_round_t();
+    verifyRound.nTimeStarted = GetTimeMillis();
+    verifyRound.nScheduled = (int)vecToVerify.size();
+
+    LogPrint("masternode", "CMasternodeMan::DoFullVerificationStep -- Scheduled verification requests to %d masternodes\n", verifyRound.nScheduled);
+}
+
+CAddress CMasternodeMan::PopScheduledVerifyRequest()
+{
+    LOCK(cs);
+    if(listScheduledVerifyRequests.empty()) return CAddress();
+
+    CAddress addr = listScheduledVerifyRequests.front();
+    listScheduledVerifyRequests.pop_front();
+    return addr;
 }
 
 // This function tries to find masternodes with the same addr,
@@ -1040,31 +1537,38 @@ void CMasternodeMan::CheckSameAddr()
     if(!masternodeSync.IsSynced() || vMasternodes.empty()) return;
 
     std::vector<CMasternode*> vBan;
-    std::vector<CMasternode*> vSortedByAddr;
 
     {
         LOCK(cs);
 
-        CMasternode* pprevMasternode = NULL;
-        CMasternode* pverifiedMasternode = NULL;
-
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-            vSortedByAddr.push_back(&mn);
-        }
-
-        sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
+        // masternodes sharing an address are next to each other in the address lookup,
+        // only those groups need to be looked at
+        lookup_addr_m_t::iterator itGroup = mapLookupAddr.begin();
+        while(itGroup != mapLookupAddr.end()) {
+            std::pair<lookup_addr_m_t::iterator, lookup_addr_m_t::iterator> range = mapLookupAddr.equal_range(itGroup->first);
+            itGroup = range.second;
 
-        BOOST_FOREACH(CMasternode* pmn, vSortedByAddr) {
-            // check only (pre)enabled masternodes
-            if(!pmn->IsEnabled() && !pmn->IsPreEnabled()) continue;
-            // initial step
-            if(!pprevMasternode) {
-                pprevMasternode = pmn;
-                pverifiedMasternode = pmn->IsPoSeVerified() ? pmn : NULL;
-                continue;
+            std::vector<size_t> vecPos;
+            for(lookup_addr_m_t::iterator itLookup = range.first; itLookup != range.second; ++itLookup) {
+                vecPos.push_back(itLookup->second);
             }
-            // second+ step
-            if(pmn->addr == pprevMasternode->addr) {
+            if(vecPos.size() < 2) continue;
+            sort(vecPos.begin(), vecPos.end());
+
+            CMasternode* pprevMasternode = NULL;
+            CMasternode* pverifiedMasternode = NULL;
+
+            BOOST_FOREACH(size_t nPos, vecPos) {
+                CMasternode* pmn = &vMasternodes[nPos];
+                // check only (pre)enabled masternodes
+                if(!pmn->IsEnabled() && !pmn->IsPreEnabled()) continue;
+                // initial step
+                if(!pprevMasternode) {
+                    pprevMasternode = pmn;
+                    pverifiedMasternode = pmn->IsPoSeVerified() ? pmn : NULL;
+                    continue;
+                }
+                // second+ step
                 if(pverifiedMasternode) {
                     // another masternode with the same ip is verified, ban this one
                     vBan.push_back(pmn);
@@ -1074,10 +1578,8 @@ void CMasternodeMan::CheckSameAddr()
                     // and keep a reference to be able to ban following masternodes with the same ip
                     pverifiedMasternode = pmn;
                 }
-            } else {
-                pverifiedMasternode = pmn->IsPoSeVerified() ? pmn : NULL;
+                pprevMasternode = pmn;
             }
-            pprevMasternode = pmn;
         }
     }
 
@@ -1086,9 +1588,12 @@ void CMasternodeMan::CheckSameAddr()
         LogPrintf("CMasternodeMan::CheckSameAddr -- increasing PoSe ban score for masternode %s\n", pmn->vin.prevout.ToStringShort());
         pmn->IncreasePoSeBanScore();
     }
+    if(!vBan.empty()) {
+        cacheGeneration.Bump();
+    }
 }
 
-bool CMasternodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<CMasternode*>& vSortedByAddr)
+bool CMasternodeMan::SendVerifyRequest(const CAddress& addr)
 {
     if(netfulfilledman.HasFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
         // we already asked for verification, not a good idea to do this too often, skip it
@@ -1096,18 +1601,31 @@ bool CMasternodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<C
         return false;
     }
 
-    CNode* pnode = ConnectNode(addr, NULL, true);
-    if(pnode == NULL) {
-        LogPrintf("CMasternodeMan::SendVerifyRequest -- can't connect to node to verify it, addr=%s\n", addr.ToString());
-        return false;
+    CNode* pnode = NULL;
+    {
+        // ConnectNode locks cs_main through GetHeight() signal
+        LOCK2(cs_main, cs_vNodes);
+        pnode = ConnectNode(addr, NULL, true);
+        if(pnode == NULL) {
+            LogPrintf("CMasternodeMan::SendVerifyRequest -- can't connect to node to verify it, addr=%s\n", addr.ToString());
+            return false;
+        }
+        pnode->AddRef();
     }
 
     netfulfilledman.AddFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request");
-    // use random nonce, store it and require node to reply with correct one later
-    CMasternodeVerification mnv(addr, GetRandInt(999999), pCurrentBlockIndex->nHeight - 1);
-    mWeAskedForVerification[addr] = mnv;
+    CMasternodeVerification mnv;
+    {
+        LOCK(cs);
+        // use random nonce, store it and require node to reply with correct one later
+        mnv = CMasternodeVerification(addr, GetRandInt(999999), pCurrentBlockIndex->nHeight - 1);
+        mWeAskedForVerification[addr] = mnv;
+        mapVerifyRequestTime[addr] = GetTimeMillis();
+        verifyRound.nSent++;
+    }
     LogPrintf("CMasternodeMan::SendVerifyRequest -- verifying node using nonce %d addr=%s\n", mnv.nonce, addr.ToString());
     pnode->PushMessage(NetMsgType::MNVERIFY, mnv);
+    pnode->Release();
 
     return true;
 }
@@ -1196,49 +1714,62 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
     {
         LOCK(cs);
 
+        std::map<CNetAddr, int64_t>::iterator itTime = mapVerifyRequestTime.find(pnode->addr);
+        if(itTime != mapVerifyRequestTime.end()) {
+            int64_t nReplyMillis = GetTimeMillis() - itTime->second;
+            verifyRound.nReplies++;
+            verifyRound.nReplyMillisTotal += nReplyMillis;
+            verifyRound.nReplyMillisMax = std::max(verifyRound.nReplyMillisMax, nReplyMillis);
+            mapVerifyRequestTime.erase(itTime);
+        }
+
         CMasternode* prealMasternode = NULL;
         std::vector<CMasternode*> vpMasternodesToBan;
-        std::vector<CMasternode>::iterator it = vMasternodes.begin();
+        // everyone claiming this address, in list order
+        std::vector<size_t> vecPos;
+        std::pair<lookup_addr_m_t::iterator, lookup_addr_m_t::iterator> range = mapLookupAddr.equal_range(pnode->addr);
+        for(lookup_addr_m_t::iterator itLookup = range.first; itLookup != range.second; ++itLookup) {
+            vecPos.push_back(itLookup->second);
+        }
+        sort(vecPos.begin(), vecPos.end());
         std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(false), mnv.nonce, blockHash.ToString());
-        while(it != vMasternodes.end()) {
-            if((CAddress)it->addr == pnode->addr) {
-                if(darkSendSigner.VerifyMessage(it->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
-                    // found it!
-                    prealMasternode = &(*it);
-                    if(!it->IsPoSeVerified()) {
-                        it->DecreasePoSeBanScore();
-                    }
-                    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
-
-                    // we can only broadcast it if we are an activated masternode
-                    if(activeMasternode.vin == CTxIn()) continue;
-                    // update ...
-                    mnv.addr = it->addr;
-                    mnv.vin1 = it->vin;
-                    mnv.vin2 = activeMasternode.vin;
-                    std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
-                                            mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
-                    // ... and sign it
-                    if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeMasternode.keyMasternode)) {
-                        LogPrintf("MasternodeMan::ProcessVerifyReply -- SignMessage() failed\n");
-                        return;
-                    }
+        BOOST_FOREACH(size_t nPos, vecPos) {
+            std::vector<CMasternode>::iterator it = vMasternodes.begin() + nPos;
+            if(darkSendSigner.VerifyMessage(it->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
+                // found it!
+                prealMasternode = &(*it);
+                if(!it->IsPoSeVerified()) {
+                    it->DecreasePoSeBanScore();
+                }
+                netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
+
+                // we can only broadcast it if we are an activated masternode
+                if(activeMasternode.vin == CTxIn()) continue;
+                // update ...
+                mnv.addr = it->addr;
+                mnv.vin1 = it->vin;
+                mnv.vin2 = activeMasternode.vin;
+                std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
+                                        mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+                // ... and sign it
+                if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeMasternode.keyMasternode)) {
+                    LogPrintf("MasternodeMan::ProcessVerifyReply -- SignMessage() failed\n");
+                    return;
+                }
 
-                    std::string strError;
+                std::string strError;
 
-                    if(!darkSendSigner.VerifyMessage(activeMasternode.pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
-                        LogPrintf("MasternodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
-                        return;
-                    }
+                if(!darkSendSigner.VerifyMessage(activeMasternode.pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
+                    LogPrintf("MasternodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
+                    return;
+                }
 
-                    mWeAskedForVerification[pnode->addr] = mnv;
-                    mnv.Relay();
+                mWeAskedForVerification[pnode->addr] = mnv;
+                mnv.Relay();
 
-                } else {
-                    vpMasternodesToBan.push_back(&(*it));
-                }
+            } else {
+                vpMasternodesToBan.push_back(&(*it));
             }
-            ++it;
         }
         // no real masternode found?...
         if(!prealMasternode) {
@@ -1383,6 +1914,7 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
     LOCK(cs);
     mapSeenMasternodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
     mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), std::make_pair(GetTime(), mnb)));
+    cacheGeneration.Bump();
 
     LogPrintf("CMasternodeMan::UpdateMasternodeList -- masternode=%s  addr=%s\n", mnb.vin.prevout.ToStringShort(), mnb.addr.ToString());
 
@@ -1394,13 +1926,70 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         }
     } else {
         CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
-        if(pmn->UpdateFromNewBroadcast(mnb)) {
+        CPubKey pubKeyMasternodeOld = pmn->pubKeyMasternode;
+        CService addrOld = pmn->addr;
+        bool fUpdated = pmn->UpdateFromNewBroadcast(mnb);
+        UpdateLookup(pmn, pubKeyMasternodeOld, addrOld);
+        if(fUpdated) {
             masternodeSync.AddedMasternodeList();
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
         }
     }
 }
 
+static void CheckMnbSignatures(std::vector<std::pair<CNode*, CMasternodeBroadcast> >& vecMnb, size_t nBegin, size_t nEnd)
+{
+    for(size_t i = nBegin; i < nEnd; i++) {
+        int nDos = 0;
+        // failures are left to CheckMnbAndUpdateMasternodeList, it checks again and handles them as usual
+        vecMnb[i].second.fSignatureVerified = vecMnb[i].second.CheckSignature(nDos);
+    }
+}
+
+void CMasternodeMan::ProcessPendingMnb()
+{
+    std::vector<std::pair<CNode*, CMasternodeBroadcast> > vecMnb;
+    {
+        LOCK(cs);
+        vecMnb.swap(vecMnbPending);
+        setMnbPendingHashes.clear();
+    }
+
+    if(vecMnb.empty()) return;
+
+    LogPrint("masternode", "CMasternodeMan::ProcessPendingMnb -- verifying %d announces\n", vecMnb.size());
+
+    // signatures don't depend on the list, so check them on all cores and without holding cs
+    size_t nThreads = std::min((size_t)std::max(GetNumCores(), 1), vecMnb.size() / MIN_MNB_THREAD_SIGS);
+    if(nThreads > 1) {
+        size_t nChunkSize = (vecMnb.size() + nThreads - 1) / nThreads;
+        boost::thread_group threadGroup;
+        for(size_t nBegin = 0; nBegin < vecMnb.size(); nBegin += nChunkSize) {
+            size_t nEnd = std::min(nBegin + nChunkSize, vecMnb.size());
+            threadGroup.create_thread(boost::bind(&CheckMnbSignatures, boost::ref(vecMnb), nBegin, nEnd));
+        }
+        threadGroup.join_all();
+    } else {
+        CheckMnbSignatures(vecMnb, 0, vecMnb.size());
+    }
+
+    BOOST_FOREACH(PAIRTYPE(CNode*, CMasternodeBroadcast)& pair, vecMnb) {
+        int nDos = 0;
+        if(CheckMnbAndUpdateMasternodeList(pair.first, pair.second, nDos)) {
+            // use announced Masternode as a peer
+            addrman.Add(CAddress(pair.second.addr), pair.first->addr, 2*60*60);
+        } else if(nDos > 0) {
+            LOCK(cs_main);
+            Misbehaving(pair.first->GetId(), nDos);
+        }
+        pair.first->Release();
+    }
+
+    if(fMasternodesAdded) {
+        NotifyMasternodeUpdates();
+    }
+}
+
 bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos)
 {
     // Need LOCK2 here to ensure consistent locking order because the SimpleCheck call below locks cs_main
@@ -1408,6 +1997,8 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
 
     nDos = 0;
     LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- masternode=%s\n", mnb.vin.prevout.ToStringShort());
+    // even a seen announce can update its time or the recovery replies
+    cacheGeneration.Bump();
 
     uint256 hash = mnb.GetHash();
     if(mapSeenMasternodeBroadcast.count(hash) && !mnb.fRecovery) { //seen
@@ -1454,7 +2045,11 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
     CMasternode* pmn = Find(mnb.vin);
     if(pmn) {
         CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
-        if(!mnb.Update(pmn, nDos)) {
+        CPubKey pubKeyMasternodeOld = pmn->pubKeyMasternode;
+        CService addrOld = pmn->addr;
+        bool fUpdated = mnb.Update(pmn, nDos);
+        UpdateLookup(pmn, pubKeyMasternodeOld, addrOld);
+        if(!fUpdated) {
             LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- Update() failed, masternode=%s\n", mnb.vin.prevout.ToStringShort());
             return false;
         }
@@ -1492,25 +2087,55 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
 
 void CMasternodeMan::UpdateLastPaid()
 {
+    if(fLiteMode) return;
+
+    {
+        // The index follows every connected block, a rebuild is only needed
+        // when mncache.dat was written for a different tip
+        LOCK(cs_main);
+        if(lastPaidIndex.Sync(mnpayments.GetStorageLimit())) {
+            cacheGeneration.Bump();
+        }
+    }
+
     LOCK(cs);
 
-    if(fLiteMode) return;
     if(!pCurrentBlockIndex) return;
 
-    static bool IsFirstRun = true;
-    // Do full scan on first run or if we are not a masternode
-    // (MNs should update this info on every block, so limited scan should be enough for them)
-    int nMaxBlocksToScanBack = (IsFirstRun || !fMasterNode) ? mnpayments.GetStorageLimit() : LAST_PAID_SCAN_BLOCKS;
-
-    // LogPrint("mnpayments", "CMasternodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
-    //                         pCurrentBlockIndex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
+    int nMinHeight = pCurrentBlockIndex->nHeight - mnpayments.GetStorageLimit();
 
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        mn.UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
+        CScript mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
+        int nBlockLastPaid = 0;
+        int64_t nTimeLastPaid = 0;
+        if(!lastPaidIndex.Get(mnpayee, nBlockLastPaid, nTimeLastPaid)) {
+            // the index covers the whole storage window, a payment within it
+            // which the index doesn't know about was disconnected
+            if(mn.nBlockLastPaid <= nMinHeight) continue;
+            nBlockLastPaid = 0;
+            nTimeLastPaid = 0;
+        }
+        if(nBlockLastPaid != mn.nBlockLastPaid) {
+            setPaymentQueue.erase(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+            mn.UpdateLastPaid(nBlockLastPaid, nTimeLastPaid);
+            setPaymentQueue.insert(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+            cacheGeneration.Bump();
+        }
     }
+}
 
-    // every time is like the first time if winners list is not synced
-    IsFirstRun = !masternodeSync.IsWinnersListSynced();
+void CMasternodeMan::BlockConnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    if(fLiteMode) return;
+    lastPaidIndex.ConnectBlock(block, pindex);
+    cacheGeneration.Bump();
+}
+
+void CMasternodeMan::BlockDisconnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    if(fLiteMode) return;
+    lastPaidIndex.DisconnectBlock(block, pindex);
+    cacheGeneration.Bump();
 }
 
 void CMasternodeMan::CheckAndRebuildMasternodeIndex()
@@ -1537,6 +2162,7 @@ void CMasternodeMan::CheckAndRebuildMasternodeIndex()
 
     fIndexRebuilt = true;
     nLastIndexRebuildTime = GetTime();
+    cacheGeneration.Bump();
 }
 
 void CMasternodeMan::UpdateWatchdogVoteTime(const CTxIn& vin)
@@ -1548,6 +2174,7 @@ void CMasternodeMan::UpdateWatchdogVoteTime(const CTxIn& vin)
     }
     pMN->UpdateWatchdogVoteTime();
     nLastWatchdogVoteTime = GetTime();
+    cacheGeneration.Bump();
 }
 
 bool CMasternodeMan::IsWatchdogActive()
@@ -1566,6 +2193,7 @@ bool CMasternodeMan::AddGovernanceVote(const CTxIn& vin, uint256 nGovernanceObje
         return false;
     }
     pMN->AddGovernanceVote(nGovernanceObjectHash);
+    cacheGeneration.Bump();
     return true;
 }
 
@@ -1575,6 +2203,7 @@ void CMasternodeMan::RemoveGovernanceObject(uint256 nGovernanceObjectHash)
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
         mn.RemoveGovernanceObject(nGovernanceObjectHash);
     }
+    cacheGeneration.Bump();
 }
 
 void CMasternodeMan::CheckMasternode(const CTxIn& vin, bool fForce)
@@ -1584,7 +2213,9 @@ void CMasternodeMan::CheckMasternode(const CTxIn& vin, bool fForce)
     if(!pMN)  {
         return;
     }
+    int nActiveStatePrev = pMN->nActiveState;
     pMN->Check(fForce);
+    if(pMN->nActiveState != nActiveStatePrev) ListChanged();
 }
 
 void CMasternodeMan::CheckMasternode(const CPubKey& pubKeyMasternode, bool fForce)
@@ -1594,7 +2225,9 @@ void CMasternodeMan::CheckMasternode(const CPubKey& pubKeyMasternode, bool fForc
     if(!pMN)  {
         return;
     }
+    int nActiveStatePrev = pMN->nActiveState;
     pMN->Check(fForce);
+    if(pMN->nActiveState != nActiveStatePrev) ListChanged();
 }
 
 int CMasternodeMan::GetMasternodeState(const CTxIn& vin)
@@ -1642,6 +2275,7 @@ void CMasternodeMan::SetMasternodeLastPing(const CTxIn& vin, const CMasternodePi
     if(mapSeenMasternodeBroadcast.count(hash)) {
         mapSeenMasternodeBroadcast[hash].second.lastPing = mnp;
     }
+    cacheGeneration.Bump();
 }
 
 void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
@@ -1649,6 +2283,11 @@ void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     pCurrentBlockIndex = pindex;
     LogPrint("masternode", "CMasternodeMan::UpdatedBlockTip -- pCurrentBlockIndex->nHeight=%d\n", pCurrentBlockIndex->nHeight);
 
+    {
+        LOCK(cs);
+        ListChanged();
+    }
+
     CheckSameAddr();
 
     if(fMasterNode) {
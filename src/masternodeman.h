@@ -7,8 +7,13 @@
 #define MASTERNODEMAN_H
 
 #include "masternode.h"
+#include "flat-database.h"
+#include "script/standard.h"
 #include "sync.h"
 
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
 using namespace std;
 
 class CMasternodeMan;
@@ -79,6 +84,91 @@ private:
 
 };
 
+/**
+ * Last payment of every masternode payee seen in the active chain, keyed by the payee script's hash.
+ *
+ * It is updated from the coinbase of each connected and disconnected block, so looking up
+ * when a masternode was paid last doesn't require scanning and reading blocks from disk.
+ * The previous payment is kept too, to be able to step back over a disconnected block,
+ * deeper reorgs of the same payee's payments are left to a rescan (nPrevBlockHeight is -1 then).
+ */
+class CMasternodeLastPaidIndex
+{
+private:
+    struct last_paid_t
+    {
+        int nBlockHeight;
+        int64_t nTime;
+        int nPrevBlockHeight;
+        int64_t nPrevTime;
+
+        last_paid_t() : nBlockHeight(0), nTime(0), nPrevBlockHeight(0), nPrevTime(0) {}
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+        {
+            READWRITE(nBlockHeight);
+            READWRITE(nTime);
+            READWRITE(nPrevBlockHeight);
+            READWRITE(nPrevTime);
+        }
+    };
+
+    typedef std::map<CScriptID, last_paid_t> last_paid_m_t;
+
+    typedef last_paid_m_t::iterator last_paid_m_it;
+
+    typedef last_paid_m_t::const_iterator last_paid_m_cit;
+
+    mutable CCriticalSection cs;
+
+    // the block the index is up to date with
+    uint256 hashBestBlock;
+
+    last_paid_m_t mapLastPaid;
+
+    /// Returns false if a disconnected payment can't be undone because the one before it is unknown
+    bool ApplyBlock(const CBlock& block, const CBlockIndex* pindex, bool fConnect);
+
+public:
+    CMasternodeLastPaidIndex() {}
+    /// Copy other, taking its lock
+    CMasternodeLastPaidIndex(const CMasternodeLastPaidIndex& other);
+    CMasternodeLastPaidIndex& operator=(const CMasternodeLastPaidIndex& other);
+
+    /// Update the index with a block connected to or disconnected from the active chain
+    void ConnectBlock(const CBlock& block, const CBlockIndex* pindex);
+    void DisconnectBlock(const CBlock& block, const CBlockIndex* pindex);
+
+    /// Rebuild the index from the last nScanBlocks blocks if it doesn't follow chainActive, returns true if it did
+    bool Sync(int nScanBlocks);
+
+    /// Get the last payment to payee, returns false if none is known
+    bool Get(const CScript& payee, int& nBlockHeightRet, int64_t& nTimeRet) const;
+
+    /// Forget payees not paid since nMinHeight, returns false if there were none
+    bool CheckAndRemove(int nMinHeight);
+
+    void Clear();
+
+    int GetSize() const {
+        LOCK(cs);
+        return mapLastPaid.size();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        LOCK(cs);
+        READWRITE(hashBestBlock);
+        READWRITE(mapLastPaid);
+    }
+};
+
 class CMasternodeMan
 {
 public:
@@ -88,6 +178,9 @@ public:
 
     typedef index_m_t::const_iterator index_m_cit;
 
+    /// Published copy of the masternode list, never modified once handed out
+    typedef boost::shared_ptr<const std::vector<CMasternode> > list_snapshot_t;
+
 private:
     static const int MAX_EXPECTED_INDEX_SIZE = 30000;
 
@@ -98,7 +191,8 @@ private:
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
 
-    static const int LAST_PAID_SCAN_BLOCKS      = 100;
+    /// Number of buckets the list is split into when peers compare their lists by digests
+    static const size_t MNLIST_DIGEST_BUCKETS   = 256;
 
     static const int MIN_POSE_PROTO_VERSION     = 70203;
     static const int MAX_POSE_CONNECTIONS       = 10;
@@ -111,15 +205,102 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    /// Announces to collect during list sync before their signatures are verified together
+    static const size_t MNB_BATCH_SIZE          = 200;
+    /// Only spread signature verification over several threads if each gets at least this many announces
+    static const size_t MIN_MNB_THREAD_SIGS     = 50;
+
+    /// Number of rank tables to keep, enough for all the heights votes and PoSe checks refer to
+    static const size_t MAX_RANK_CACHE_SIZE     = 32;
+    /// Only spread score calculation over several threads if each gets at least this many masternodes
+    static const size_t MIN_RANK_THREAD_SCORES  = 500;
+
+    /// Check() republishes the list snapshot this often even if no change was flagged, to pick up pings
+    static const int64_t LIST_SNAPSHOT_REFRESH_SECONDS  = 5;
+    /// Readers publish a fresh snapshot themselves if the last one is older, i.e. when Check() isn't running yet
+    static const int64_t LIST_SNAPSHOT_MAX_AGE_SECONDS  = 30;
+
+    /// Salted hasher for the lookup maps below
+    class CLookupHasher
+    {
+    private:
+        uint64_t k0, k1;
+
+    public:
+        CLookupHasher();
+
+        size_t operator()(const COutPoint& outpoint) const;
+        size_t operator()(const CPubKey& pubKey) const;
+        size_t operator()(const CScript& script) const;
+        size_t operator()(const CService& addr) const;
+    };
+
+    typedef boost::unordered_map<COutPoint, size_t, CLookupHasher> lookup_outpoint_m_t;
+    typedef boost::unordered_multimap<CPubKey, size_t, CLookupHasher> lookup_pubkey_m_t;
+    typedef boost::unordered_multimap<CScript, size_t, CLookupHasher> lookup_payee_m_t;
+    typedef boost::unordered_multimap<CService, size_t, CLookupHasher> lookup_addr_m_t;
+
+    /// Masternodes by last paid block and collateral outpoint, the order they are considered for payment in
+    typedef std::set<std::pair<int, COutPoint> > payment_queue_t;
+
+    /// Which masternodes take part in a ranking
+    enum rank_filter_t {
+        RANK_FILTER_NONE,
+        RANK_FILTER_ENABLED,
+        RANK_FILTER_VALID_FOR_PAYMENT
+    };
+
+    /// Masternodes ordered by their score for one block, best first
+    struct rank_table_t
+    {
+        std::vector<COutPoint> vecRanked;
+        boost::unordered_map<COutPoint, int, CLookupHasher> mapRank;
+        int64_t nLastUsed;
+    };
+
+    /// Progress of the PoSe verification requests scheduled by one DoFullVerificationStep() call
+    struct verify_round_t
+    {
+        int64_t nTimeStarted;
+        int nScheduled;
+        int nSent;
+        int nReplies;
+        int64_t nReplyMillisTotal;
+        int64_t nReplyMillisMax;
+
+        verify_round_t() : nTimeStarted(0), nScheduled(0), nSent(0), nReplies(0), nReplyMillisTotal(0), nReplyMillisMax(0) {}
+    };
+
+    /// Block hash, min protocol version and filter of a ranking
+    typedef std::pair<uint256, std::pair<int, int> > rank_key_t;
+    typedef std::map<rank_key_t, rank_table_t> rank_m_t;
+    typedef rank_m_t::iterator rank_m_it;
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    // only protects pListSnapshot and nListSnapshotTime, so readers never wait for cs while the list is updated
+    mutable CCriticalSection cs_snapshot;
+    list_snapshot_t pListSnapshot;
+    int64_t nListSnapshotTime;
+
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
     // map to hold all MNs
     std::vector<CMasternode> vMasternodes;
+    // positions in vMasternodes by collateral outpoint, masternode pubkey, payee script and address
+    lookup_outpoint_m_t mapLookupOutpoint;
+    lookup_pubkey_m_t mapLookupPubKey;
+    lookup_payee_m_t mapLookupPayee;
+    lookup_addr_m_t mapLookupAddr;
+    // follows nBlockLastPaid of every masternode, see UpdateLastPaid()
+    payment_queue_t setPaymentQueue;
+    // cached rankings, dropped whenever the list or the state of any masternode changes
+    rank_m_t mapRankCache;
+    int64_t nRankCacheUseCount;
+    // set whenever the list or the state of a masternode changed since the last snapshot was published
+    bool fListSnapshotDirty;
     // who's asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
     // who we asked for the Masternode list and the last time
@@ -128,18 +309,29 @@ private:
     std::map<COutPoint, std::map<CNetAddr, int64_t> > mWeAskedForMasternodeListEntry;
     // who we asked for the masternode verification
     std::map<CNetAddr, CMasternodeVerification> mWeAskedForVerification;
+    // verification requests of the current round waiting for the connection thread, see PopScheduledVerifyRequest()
+    std::list<CAddress> listScheduledVerifyRequests;
+    // when the requests of the current round were sent, to measure how long replies take
+    std::map<CNetAddr, int64_t> mapVerifyRequestTime;
+    verify_round_t verifyRound;
 
     // these maps are used for masternode recovery from MASTERNODE_NEW_START_REQUIRED state
     std::map<uint256, std::pair< int64_t, std::set<CNetAddr> > > mMnbRecoveryRequests;
     std::map<uint256, std::vector<CMasternodeBroadcast> > mMnbRecoveryGoodReplies;
     std::list< std::pair<CService, uint256> > listScheduledMnbRequestConnections;
 
+    // announces received during list sync waiting for ProcessPendingMnb(), nodes are referenced until then
+    std::vector<std::pair<CNode*, CMasternodeBroadcast> > vecMnbPending;
+    std::set<uint256> setMnbPendingHashes;
+
     int64_t nLastIndexRebuildTime;
 
     CMasternodeIndex indexMasternodes;
 
     CMasternodeIndex indexMasternodesOld;
 
+    CMasternodeLastPaidIndex lastPaidIndex;
+
     /// Set when index has been rebuilt, clear when read
     bool fIndexRebuilt;
 
@@ -153,9 +345,82 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // bumped whenever the state written to mncache.dat changes, see MarkCacheChanged()
+    CFlatDBGeneration cacheGeneration;
+
     friend class CMasternodeSync;
 
+    /// Add the masternode at position nPos of vMasternodes to the lookup maps and the payment queue
+    void AddToLookup(size_t nPos);
+    /// Update the lookup maps after pubKeyMasternode or addr of pmn changed
+    void UpdateLookup(const CMasternode* pmn, const CPubKey& pubKeyMasternodeOld, const CService& addrOld);
+    /// Recreate the lookup maps, needed whenever entries are removed from vMasternodes
+    void RebuildLookup();
+
+    /// Ranking of the masternodes for blockHash, calculated on first use and cached until the list changes
+    const rank_table_t& GetRankTable(const uint256& blockHash, int nMinProtocol, rank_filter_t filter);
+    /// Drop cached rankings and flag the list snapshot as stale, call whenever masternodes or their state change
+    void ListChanged();
+    /// Copy vMasternodes and hand the copy to readers in place of the previous one
+    void PublishListSnapshot();
+
+    /// Rate limit full list requests from the same peer, returns false if pfrom asked too early
+    bool CheckListRequest(CNode* pfrom);
+    /// Whether mn is handed out to peers syncing the list
+    bool IsSentToPeers(CMasternode& mn);
+    static size_t GetListDigestBucket(const COutPoint& outpoint);
+    /// Per bucket, XOR of the hashes of (outpoint, announce hash) and of (outpoint, ping hash) of the masternodes in it
+    void GetListDigests(std::vector<uint256>& vecAnnounceDigestsRet, std::vector<uint256>& vecPingDigestsRet);
+    void PushListEntry(CNode* pnode, const CMasternode& mn, bool fAnnounce, bool fPing);
+
+    /// The sections of mncache.dat, shared by loading them into the manager and writing them from a cache_snapshot_t
+    template <typename Stream, typename Operation, typename State>
+    static void SerializeCache(Stream& s, Operation ser_action, int nType, int nVersion, State& state, std::string& strVersion, bool& fDamaged) {
+        READWRITE(FLATDB_SECTION(strVersion));
+        // the masternodes, the seen messages and the index only make sense together,
+        // losing one of them drops the whole list like a version mismatch does
+        READWRITE(FLATDB_SECTION_CHECKED(state.vMasternodes, fDamaged));
+        READWRITE(FLATDB_SECTION(state.mAskedUsForMasternodeList));
+        READWRITE(FLATDB_SECTION(state.mWeAskedForMasternodeList));
+        READWRITE(FLATDB_SECTION(state.mWeAskedForMasternodeListEntry));
+        READWRITE(FLATDB_SECTION(state.mMnbRecoveryRequests));
+        READWRITE(FLATDB_SECTION(state.mMnbRecoveryGoodReplies));
+        READWRITE(FLATDB_SECTION(state.nLastWatchdogVoteTime));
+        READWRITE(FLATDB_SECTION(state.nDsqCount));
+
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapSeenMasternodeBroadcast, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.mapSeenMasternodePing, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(state.indexMasternodes, fDamaged));
+        READWRITE(FLATDB_SECTION(state.lastPaidIndex));
+    }
+
 public:
+    /// Copy of the state written to mncache.dat, serialized without holding cs
+    struct cache_snapshot_t
+    {
+        std::vector<CMasternode> vMasternodes;
+        std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
+        std::map<CNetAddr, int64_t> mWeAskedForMasternodeList;
+        std::map<COutPoint, std::map<CNetAddr, int64_t> > mWeAskedForMasternodeListEntry;
+        std::map<uint256, std::pair< int64_t, std::set<CNetAddr> > > mMnbRecoveryRequests;
+        std::map<uint256, std::vector<CMasternodeBroadcast> > mMnbRecoveryGoodReplies;
+        int64_t nLastWatchdogVoteTime;
+        int64_t nDsqCount;
+        std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> > mapSeenMasternodeBroadcast;
+        std::map<uint256, CMasternodePing> mapSeenMasternodePing;
+        CMasternodeIndex indexMasternodes;
+        CMasternodeLastPaidIndex lastPaidIndex;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+            std::string strVersion = SERIALIZATION_VERSION_STRING;
+            bool fDamaged = false;
+            SerializeCache(s, ser_action, nType, nVersion, *this, strVersion, fDamaged);
+        }
+    };
+
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> > mapSeenMasternodeBroadcast;
     // Keep track of all pings I've seen
@@ -170,33 +435,32 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        LOCK(cs);
-        std::string strVersion;
-        if(ser_action.ForRead()) {
-            READWRITE(strVersion);
-        }
-        else {
-            strVersion = SERIALIZATION_VERSION_STRING; 
-            READWRITE(strVersion);
+        if(!ser_action.ForRead()) {
+            // write a copy, so cs is only held while it is taken
+            cache_snapshot_t snapshot;
+            GetCacheSnapshot(snapshot);
+            READWRITE(snapshot);
+            return;
         }
 
-        READWRITE(vMasternodes);
-        READWRITE(mAskedUsForMasternodeList);
-        READWRITE(mWeAskedForMasternodeList);
-        READWRITE(mWeAskedForMasternodeListEntry);
-        READWRITE(mMnbRecoveryRequests);
-        READWRITE(mMnbRecoveryGoodReplies);
-        READWRITE(nLastWatchdogVoteTime);
-        READWRITE(nDsqCount);
-
-        READWRITE(mapSeenMasternodeBroadcast);
-        READWRITE(mapSeenMasternodePing);
-        READWRITE(indexMasternodes);
-        if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
+        LOCK(cs);
+        std::string strVersion;
+        bool fDamaged = false;
+        SerializeCache(s, ser_action, nType, nVersion, *this, strVersion, fDamaged);
+        if(strVersion != SERIALIZATION_VERSION_STRING || fDamaged) {
             Clear();
         }
+        RebuildLookup();
+        cacheGeneration.Bump();
     }
 
+    /// Copy the state written to mncache.dat
+    void GetCacheSnapshot(cache_snapshot_t& snapshotRet) const;
+    /// Changes whenever the state written to mncache.dat does, doesn't take cs
+    uint64_t GetCacheGeneration() const { return cacheGeneration.Get(); }
+    /// Call after changing anything written to mncache.dat, including the masternodes handed out by Find()
+    void MarkCacheChanged() { cacheGeneration.Bump(); }
+
     CMasternodeMan();
 
     /// Add an entry
@@ -293,7 +557,8 @@ public:
     /// Find a random entry
     CMasternode* FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion = -1);
 
-    std::vector<CMasternode> GetFullMasternodeVector() { return vMasternodes; }
+    /// Copy of the whole list that is safe to use without any lock, at most a few seconds old
+    list_snapshot_t GetListSnapshot();
 
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
     int GetMasternodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
@@ -304,9 +569,11 @@ public:
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
+    /// Schedule verification requests to the masternodes this one is responsible for, they are sent by the connection thread
     void DoFullVerificationStep();
+    CAddress PopScheduledVerifyRequest();
     void CheckSameAddr();
-    bool SendVerifyRequest(const CAddress& addr, const std::vector<CMasternode*>& vSortedByAddr);
+    bool SendVerifyRequest(const CAddress& addr);
     void SendVerifyReply(CNode* pnode, CMasternodeVerification& mnv);
     void ProcessVerifyReply(CNode* pnode, CMasternodeVerification& mnv);
     void ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerification& mnv);
@@ -321,9 +588,15 @@ public:
     /// Perform complete check and only then update list and maps
     bool CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
+    /// Verify signatures of the announces queued during list sync in parallel, then add them to the list
+    void ProcessPendingMnb();
 
     void UpdateLastPaid();
 
+    /// Keep the last paid index in sync with the active chain, cs_main must be held
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex);
+    void BlockDisconnected(const CBlock& block, const CBlockIndex* pindex);
+
     void CheckAndRebuildMasternodeIndex();
 
     void AddDirtyGovernanceObjectHash(const uint256& nHash)
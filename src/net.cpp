@@ -97,9 +97,7 @@ std::string strSubVersion;
 
 vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-map<CInv, CDataStream> mapRelay;
-deque<pair<int64_t, CInv> > vRelayExpiration;
-CCriticalSection cs_mapRelay;
+CRelayCache relaycache;
 limitedmap<uint256, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
 
 static deque<string> vOneShots;
@@ -1709,6 +1707,23 @@ void ThreadMnbRequestConnections()
     }
 }
 
+void ThreadMnVerifyConnections()
+{
+    while (true)
+    {
+        // send all requests of a verification round right away, connecting may take a while for each of them
+        CAddress addr = mnodeman.PopScheduledVerifyRequest();
+        if(addr == CAddress()) {
+            MilliSleep(1000);
+            boost::this_thread::interruption_point();
+            continue;
+        }
+
+        boost::this_thread::interruption_point();
+        mnodeman.SendVerifyRequest(addr);
+    }
+}
+
 // if successful, this moves the passed grant to the constructed node
 bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOutbound, const char *pszDest, bool fOneShot)
 {
@@ -2009,6 +2024,9 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
     // Initiate masternode connections
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "mnbcon", &ThreadMnbRequestConnections));
 
+    // Send masternode verification requests
+    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "mnverify", &ThreadMnVerifyConnections));
+
     // Process messages
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
 
@@ -2106,19 +2124,8 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
     int nInv = mapDarksendBroadcastTxes.count(hash) ? MSG_DSTX :
                 (instantsend.HasTxLockRequest(hash) ? MSG_TXLOCK_REQUEST : MSG_TX);
     CInv inv(nInv, hash);
-    {
-        LOCK(cs_mapRelay);
-        // Expire old relay messages
-        while (!vRelayExpiration.empty() && vRelayExpiration.front().first < GetTime())
-        {
-            mapRelay.erase(vRelayExpiration.front().second);
-            vRelayExpiration.pop_front();
-        }
-
-        // Save original serialized message so newer versions are preserved
-        mapRelay.insert(std::make_pair(inv, ss));
-        vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
-    }
+    // Save original serialized message so newer versions are preserved
+    relaycache.Insert(inv, ss);
     LOCK(cs_vNodes);
     BOOST_FOREACH(CNode* pnode, vNodes)
     {
@@ -2304,13 +2311,6 @@ bool CAddrDB::Write(const CAddrMan& addr)
     GetRandBytes((unsigned char*)&randv, sizeof(randv));
     std::string tmpfn = strprintf("peers.dat.%04x", randv);
 
-    // serialize addresses, checksum data up to that point, then append csum
-    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
-    ssPeers << FLATDATA(Params().MessageStart());
-    ssPeers << addr;
-    uint256 hash = Hash(ssPeers.begin(), ssPeers.end());
-    ssPeers << hash;
-
     // open temp output file, and associate with CAutoFile
     boost::filesystem::path pathTmp = GetDataDir() / tmpfn;
     FILE *file = fopen(pathTmp.string().c_str(), "wb");
@@ -2318,9 +2318,12 @@ bool CAddrDB::Write(const CAddrMan& addr)
     if (fileout.IsNull())
         return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-    // Write and commit header, data
+    // stream addresses straight to the file, checksum data up to that point, then append csum
     try {
-        fileout << ssPeers;
+        CHashingWriter<CAutoFile> hashout(&fileout);
+        hashout << FLATDATA(Params().MessageStart());
+        hashout << addr;
+        fileout << hashout.GetHash();
     }
     catch (const std::exception& e) {
         return error("%s: Serialize or I/O error - %s", __func__, e.what());
@@ -2343,46 +2346,30 @@ bool CAddrDB::Read(CAddrMan& addr)
     if (filein.IsNull())
         return error("%s: Failed to open file %s", __func__, pathAddr.string());
 
-    // use file size to size memory buffer
-    uint64_t fileSize = boost::filesystem::file_size(pathAddr);
-    uint64_t dataSize = 0;
-    // Don't try to resize to a negative number if file is small
-    if (fileSize >= sizeof(uint256))
-        dataSize = fileSize - sizeof(uint256);
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char *)&vchData[0], dataSize);
-        filein >> hashIn;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-    }
-    filein.fclose();
-
-    CDataStream ssPeers(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssPeers.begin(), ssPeers.end());
-    if (hashIn != hashTmp)
-        return error("%s: Checksum mismatch, data corrupted", __func__);
-
+    // deserialize straight from the file while hashing everything read
+    CHashVerifier<CAutoFile> verifier(&filein);
     unsigned char pchMsgTmp[4];
     try {
         // de-serialize file header (network specific magic number) and ..
-        ssPeers >> FLATDATA(pchMsgTmp);
+        verifier >> FLATDATA(pchMsgTmp);
 
         // ... verify the network matches ours
         if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
             return error("%s: Invalid network magic number", __func__);
 
         // de-serialize address data into one CAddrMan object
-        ssPeers >> addr;
+        verifier >> addr;
+
+        // verify stored checksum matches input data
+        uint256 hashIn;
+        filein >> hashIn;
+        if (hashIn != verifier.GetHash()) {
+            addr.Clear();
+            return error("%s: Checksum mismatch, data corrupted", __func__);
+        }
     }
     catch (const std::exception& e) {
+        addr.Clear();
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
 
@@ -12,6 +12,7 @@
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
+#include "relaycache.h"
 #include "streams.h"
 #include "sync.h"
 #include "uint256.h"
@@ -165,9 +166,7 @@ extern int nMaxConnections;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
-extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
-extern CCriticalSection cs_mapRelay;
+extern CRelayCache relaycache;
 extern limitedmap<uint256, int64_t> mapAlreadyAskedFor;
 
 extern std::vector<std::string> vAddedNodes;
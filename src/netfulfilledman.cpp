@@ -13,6 +13,7 @@ void CNetFulfilledRequestManager::AddFulfilledRequest(CAddress addr, std::string
 {
     LOCK(cs_mapFulfilledRequests);
     mapFulfilledRequests[addr][strRequest] = GetTime() + Params().FulfilledRequestExpireTime();
+    cacheGeneration.Bump();
 }
 
 bool CNetFulfilledRequestManager::HasFulfilledRequest(CAddress addr, std::string strRequest)
@@ -30,8 +31,8 @@ void CNetFulfilledRequestManager::RemoveFulfilledRequest(CAddress addr, std::str
     LOCK(cs_mapFulfilledRequests);
     fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
 
-    if (it != mapFulfilledRequests.end()) {
-        it->second.erase(strRequest);
+    if (it != mapFulfilledRequests.end() && it->second.erase(strRequest)) {
+        cacheGeneration.Bump();
     }
 }
 
@@ -47,6 +48,7 @@ void CNetFulfilledRequestManager::CheckAndRemove()
         while(it_entry != it->second.end()) {
             if(now > it_entry->second) {
                 it->second.erase(it_entry++);
+                cacheGeneration.Bump();
             } else {
                 ++it_entry;
             }
@@ -63,6 +65,7 @@ void CNetFulfilledRequestManager::Clear()
 {
     LOCK(cs_mapFulfilledRequests);
     mapFulfilledRequests.clear();
+    cacheGeneration.Bump();
 }
 
 std::string CNetFulfilledRequestManager::ToString() const
@@ -7,6 +7,7 @@
 #define NETFULFILLEDMAN_H
 
 #include "netbase.h"
+#include "flat-database.h"
 #include "protocol.h"
 #include "serialize.h"
 #include "sync.h"
@@ -26,6 +27,9 @@ private:
     fulfilledreqmap_t mapFulfilledRequests;
     CCriticalSection cs_mapFulfilledRequests;
 
+    // bumped whenever the requests change, see GetCacheGeneration()
+    CFlatDBGeneration cacheGeneration;
+
 public:
     CNetFulfilledRequestManager() {}
 
@@ -33,8 +37,20 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        if(!ser_action.ForRead()) {
+            // write a copy, so the requests are only locked while it is taken
+            fulfilledreqmap_t mapFulfilledRequestsCopy;
+            {
+                LOCK(cs_mapFulfilledRequests);
+                mapFulfilledRequestsCopy = mapFulfilledRequests;
+            }
+            READWRITE(FLATDB_SECTION(mapFulfilledRequestsCopy));
+            return;
+        }
+
         LOCK(cs_mapFulfilledRequests);
-        READWRITE(mapFulfilledRequests);
+        READWRITE(FLATDB_SECTION(mapFulfilledRequests));
+        cacheGeneration.Bump();
     }
 
     void AddFulfilledRequest(CAddress addr, std::string strRequest); // expire after 1 hour by default
@@ -44,6 +60,9 @@ public:
     void CheckAndRemove();
     void Clear();
 
+    /// Changes whenever the requests do, doesn't take their lock
+    uint64_t GetCacheGeneration() const { return cacheGeneration.Get(); }
+
     std::string ToString() const;
 };
 
@@ -239,10 +239,12 @@ extern const char *DSSTATUSUPDATE;
 extern const char *DSTX;
 extern const char *DSQUEUE;
 extern const char *DSEG;
+extern const char *MNLISTDIGEST;
 extern const char *SYNCSTATUSCOUNT;
 extern const char *MNGOVERNANCESYNC;
 extern const char *MNGOVERNANCEOBJECT;
 extern const char *MNGOVERNANCEOBJECTVOTE;
+extern const char *MNGOVERNANCEVOTESKETCH;
 extern const char *MNVERIFY;
 };
 
@@ -324,6 +326,7 @@ public:
     }
 
     friend bool operator<(const CInv& a, const CInv& b);
+    friend bool operator==(const CInv& a, const CInv& b);
 
     bool IsKnownType() const;
     const char* GetCommand() const;
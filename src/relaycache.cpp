@@ -0,0 +1,169 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "relaycache.h"
+#include "memusage.h"
+#include "random.h"
+#include "util.h"
+#include "utiltime.h"
+#include "version.h"
+
+int64_t GetRelayCacheTTL(int nInvType)
+{
+    switch(nInvType) {
+        // DSTX and lock requests can also be served from darksend/instantsend
+        // storage, only keep the exact relayed bytes for a short while
+        case MSG_DSTX:
+        case MSG_TXLOCK_REQUEST:
+            return 5 * 60;
+        default:
+            return 15 * 60;
+    }
+}
+
+CRelayCache::CInvHasher::CInvHasher() : salt(GetRandHash()) {}
+
+CRelayCache::CRelayEntry::CRelayEntry(const CDataStream& ssIn, int64_t nTimeExpireIn) :
+    // copy only the used bytes, relayed streams are usually over-reserved
+    ss(ssIn.begin(), ssIn.end(), SER_NETWORK, PROTOCOL_VERSION),
+    nTimeExpire(nTimeExpireIn)
+{
+    // rough per-entry overhead: map node, expiration node and the stream buffer
+    nUsage = memusage::MallocUsage(ss.size()) +
+             memusage::MallocUsage(sizeof(std::pair<const CInv, CRelayEntry>) + sizeof(void*)) +
+             memusage::MallocUsage(sizeof(std::pair<const int64_t, CInv>) + 3 * sizeof(void*));
+}
+
+CRelayCache::CRelayCache() :
+    nMaxBytesPerShard(DEFAULT_MAX_RELAY_CACHE * 1024 * 1024 / RELAY_CACHE_SHARDS)
+{}
+
+int CRelayCache::GetShardIndex(const CInv& inv) const
+{
+    // use the upper bits so that shard selection is independent from bucket selection
+    return (hasher.Hash(inv) >> 32) % RELAY_CACHE_SHARDS;
+}
+
+void CRelayCache::SetMaxSize(size_t nMaxBytes)
+{
+    nMaxBytesPerShard = nMaxBytes / RELAY_CACHE_SHARDS;
+}
+
+void CRelayCache::EraseEntry(CShard& shard, relaymap_t::iterator it)
+{
+    std::pair<expirationmap_t::iterator, expirationmap_t::iterator> range = shard.mapExpiration.equal_range(it->second.nTimeExpire);
+    for(expirationmap_t::iterator itExp = range.first; itExp != range.second; ++itExp) {
+        if(itExp->second == it->first) {
+            shard.mapExpiration.erase(itExp);
+            break;
+        }
+    }
+    shard.nBytes -= it->second.nUsage;
+    shard.mapRelay.erase(it);
+}
+
+void CRelayCache::ExpireShard(CShard& shard, int64_t nNow)
+{
+    AssertLockHeld(shard.cs);
+    while(!shard.mapExpiration.empty() && shard.mapExpiration.begin()->first < nNow) {
+        relaymap_t::iterator it = shard.mapRelay.find(shard.mapExpiration.begin()->second);
+        assert(it != shard.mapRelay.end());
+        EraseEntry(shard, it);
+        ++shard.nExpirations;
+    }
+}
+
+void CRelayCache::Insert(const CInv& inv, const CDataStream& ss)
+{
+    CShard& shard = vShards[GetShardIndex(inv)];
+    int64_t nNow = GetTime();
+    CRelayEntry entry(ss, nNow + GetRelayCacheTTL(inv.type));
+
+    // a single message that doesn't fit into a shard is not worth keeping
+    if(entry.nUsage > nMaxBytesPerShard) return;
+
+    LOCK(shard.cs);
+    ExpireShard(shard, nNow);
+
+    relaymap_t::iterator it = shard.mapRelay.find(inv);
+    if(it != shard.mapRelay.end()) {
+        EraseEntry(shard, it);
+    }
+
+    // make room by dropping the entries that would expire first
+    while(shard.nBytes + entry.nUsage > nMaxBytesPerShard && !shard.mapExpiration.empty()) {
+        relaymap_t::iterator itOldest = shard.mapRelay.find(shard.mapExpiration.begin()->second);
+        assert(itOldest != shard.mapRelay.end());
+        EraseEntry(shard, itOldest);
+        ++shard.nEvictions;
+    }
+
+    shard.nBytes += entry.nUsage;
+    shard.mapExpiration.insert(std::make_pair(entry.nTimeExpire, inv));
+    shard.mapRelay.insert(std::make_pair(inv, entry));
+}
+
+bool CRelayCache::Get(const CInv& inv, CDataStream& ssRet)
+{
+    CShard& shard = vShards[GetShardIndex(inv)];
+    LOCK(shard.cs);
+    relaymap_t::iterator it = shard.mapRelay.find(inv);
+    if(it == shard.mapRelay.end() || it->second.nTimeExpire < GetTime()) {
+        ++shard.nMisses;
+        return false;
+    }
+    ssRet += it->second.ss;
+    ++shard.nHits;
+    return true;
+}
+
+bool CRelayCache::Has(const CInv& inv) const
+{
+    const CShard& shard = vShards[GetShardIndex(inv)];
+    LOCK(shard.cs);
+    relaymap_t::const_iterator it = shard.mapRelay.find(inv);
+    return it != shard.mapRelay.end() && it->second.nTimeExpire >= GetTime();
+}
+
+void CRelayCache::Expire()
+{
+    int64_t nNow = GetTime();
+    for(int i = 0; i < RELAY_CACHE_SHARDS; i++) {
+        LOCK(vShards[i].cs);
+        ExpireShard(vShards[i], nNow);
+    }
+}
+
+void CRelayCache::Clear()
+{
+    for(int i = 0; i < RELAY_CACHE_SHARDS; i++) {
+        LOCK(vShards[i].cs);
+        vShards[i].mapRelay.clear();
+        vShards[i].mapExpiration.clear();
+        vShards[i].nBytes = 0;
+    }
+}
+
+CRelayCacheStats CRelayCache::GetStats() const
+{
+    CRelayCacheStats stats;
+    stats.nMaxBytes = nMaxBytesPerShard * RELAY_CACHE_SHARDS;
+    for(int i = 0; i < RELAY_CACHE_SHARDS; i++) {
+        LOCK(vShards[i].cs);
+        stats.nEntries += vShards[i].mapRelay.size();
+        stats.nBytes += vShards[i].nBytes;
+        stats.nHits += vShards[i].nHits;
+        stats.nMisses += vShards[i].nMisses;
+        stats.nEvictions += vShards[i].nEvictions;
+        stats.nExpirations += vShards[i].nExpirations;
+    }
+    return stats;
+}
+
+std::string CRelayCache::ToString() const
+{
+    CRelayCacheStats stats = GetStats();
+    return strprintf("Relay cache: entries: %d, bytes: %d/%d, hits: %d, misses: %d, evictions: %d, expirations: %d",
+                    stats.nEntries, stats.nBytes, stats.nMaxBytes, stats.nHits, stats.nMisses, stats.nEvictions, stats.nExpirations);
+}
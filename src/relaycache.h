@@ -0,0 +1,119 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef RELAYCACHE_H
+#define RELAYCACHE_H
+
+#include "protocol.h"
+#include "streams.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+
+#include <boost/unordered_map.hpp>
+
+/** Default for -maxrelaycache, in MiB */
+static const unsigned int DEFAULT_MAX_RELAY_CACHE = 50;
+/** Number of independently locked shards the relay cache is split into */
+static const int RELAY_CACHE_SHARDS = 16;
+
+/** Time to keep a relayed message of the given inv type around for getdata requests */
+int64_t GetRelayCacheTTL(int nInvType);
+
+struct CRelayCacheStats
+{
+    size_t nEntries;
+    size_t nBytes;
+    size_t nMaxBytes;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nEvictions;
+    uint64_t nExpirations;
+
+    CRelayCacheStats() : nEntries(0), nBytes(0), nMaxBytes(0), nHits(0), nMisses(0), nEvictions(0), nExpirations(0) {}
+};
+
+/**
+ * Memory-bounded cache of serialized messages we relayed, used to answer getdata
+ * with the exact bytes we announced. Entries expire after a per-inv-type TTL and
+ * the oldest ones are evicted once the byte budget is exceeded. The cache is split
+ * into shards selected by a salted hash so that lookups from the message handler
+ * and inserts from relaying threads rarely contend on the same lock.
+ */
+class CRelayCache
+{
+private:
+    class CInvHasher
+    {
+    private:
+        uint256 salt;
+
+    public:
+        CInvHasher();
+
+        uint64_t Hash(const CInv& inv) const {
+            return inv.hash.GetHash(salt) ^ (uint64_t)inv.type;
+        }
+
+        size_t operator()(const CInv& inv) const {
+            return Hash(inv);
+        }
+    };
+
+    struct CRelayEntry
+    {
+        CDataStream ss;
+        int64_t nTimeExpire;
+        size_t nUsage;
+
+        CRelayEntry(const CDataStream& ssIn, int64_t nTimeExpireIn);
+    };
+
+    typedef boost::unordered_map<CInv, CRelayEntry, CInvHasher> relaymap_t;
+    typedef std::multimap<int64_t, CInv> expirationmap_t;
+
+    struct CShard
+    {
+        mutable CCriticalSection cs;
+        relaymap_t mapRelay;
+        expirationmap_t mapExpiration;
+        size_t nBytes;
+        uint64_t nHits;
+        uint64_t nMisses;
+        uint64_t nEvictions;
+        uint64_t nExpirations;
+
+        CShard() : nBytes(0), nHits(0), nMisses(0), nEvictions(0), nExpirations(0) {}
+    };
+
+    CInvHasher hasher;
+    CShard vShards[RELAY_CACHE_SHARDS];
+    size_t nMaxBytesPerShard;
+
+    int GetShardIndex(const CInv& inv) const;
+    void EraseEntry(CShard& shard, relaymap_t::iterator it);
+    void ExpireShard(CShard& shard, int64_t nNow);
+
+public:
+    CRelayCache();
+
+    /** Set the total byte budget, shared equally between the shards */
+    void SetMaxSize(size_t nMaxBytes);
+
+    /** Remember the serialized message for inv, replacing any previous one */
+    void Insert(const CInv& inv, const CDataStream& ss);
+    /** Append the cached message for inv to ssRet, returns false if unknown or expired */
+    bool Get(const CInv& inv, CDataStream& ssRet);
+    bool Has(const CInv& inv) const;
+
+    /** Drop all expired entries */
+    void Expire();
+    void Clear();
+
+    CRelayCacheStats GetStats() const;
+    std::string ToString() const;
+};
+
+#endif
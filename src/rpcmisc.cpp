@@ -6,6 +6,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "cachedump.h"
 #include "clientversion.h"
 #include "init.h"
 #include "main.h"
@@ -177,6 +178,50 @@ UniValue mnsync(const UniValue& params, bool fHelp)
     return "failure";
 }
 
+UniValue getcachedumpinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getcachedumpinfo\n"
+            "Returns the state of the periodic dumps of the masternode, payment, governance and fulfilled requests caches.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"interval\": xxxxx,           (numeric) seconds between dumps, 0 if disabled\n"
+            "  \"files\": {\n"
+            "    \"filename\": {\n"
+            "      \"time\": xxxxx,           (numeric) time of the last dump in seconds since epoch\n"
+            "      \"duration\": xxxxx,       (numeric) duration of the last dump in milliseconds\n"
+            "      \"size\": xxxxx,           (numeric) size of the last snapshot in bytes\n"
+            "      \"success\": true|false,   (boolean) whether the last dump succeeded\n"
+            "      \"written\": xxxxx,        (numeric) number of dumps that wrote the file\n"
+            "      \"unchanged\": xxxxx       (numeric) number of dumps skipped because nothing changed\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getcachedumpinfo", "")
+            + HelpExampleRpc("getcachedumpinfo", "")
+        );
+
+    UniValue objFiles(UniValue::VOBJ);
+    std::map<std::string, CCacheDumpStats> mapStats = GetCacheDumpStats();
+    for (std::map<std::string, CCacheDumpStats>::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it) {
+        UniValue objFile(UniValue::VOBJ);
+        objFile.push_back(Pair("time", it->second.nTime));
+        objFile.push_back(Pair("duration", it->second.nDurationMillis));
+        objFile.push_back(Pair("size", (uint64_t)it->second.nSize));
+        objFile.push_back(Pair("success", it->second.fSuccess));
+        objFile.push_back(Pair("written", it->second.nWritten));
+        objFile.push_back(Pair("unchanged", it->second.nUnchanged));
+        objFiles.push_back(Pair(it->first, objFile));
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("interval", GetCacheDumpInterval()));
+    obj.push_back(Pair("files", objFiles));
+    return obj;
+}
+
 #ifdef ENABLE_WALLET
 class DescribeAddressVisitor : public boost::static_visitor<UniValue>
 {
@@ -112,7 +112,13 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"inflight_limit\": n,        (numeric) How many blocks we currently allow to be in flight from this peer\n"
+            "    \"blocks_received\": n,       (numeric) The number of requested blocks received from this peer\n"
+            "    \"block_bytes_received\": n,  (numeric) The total size of the requested blocks received from this peer\n"
+            "    \"block_time\": n,            (numeric) Average time in seconds the peer needs to deliver the next queued block\n"
+            "    \"block_rate\": n,            (numeric) Measured block download speed from this peer in bytes per second\n"
+            "    \"blocks_rerequested\": n     (numeric) The number of blocks requested from faster peers because this one stalled\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -164,6 +170,12 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            obj.push_back(Pair("inflight_limit", statestats.nMaxBlocksInFlight));
+            obj.push_back(Pair("blocks_received", statestats.nBlocksReceived));
+            obj.push_back(Pair("block_bytes_received", statestats.nBlockBytesReceived));
+            obj.push_back(Pair("block_time", statestats.nBlockTimeAvg / 1e6));
+            obj.push_back(Pair("block_rate", statestats.nBlockBytesPerSecond));
+            obj.push_back(Pair("blocks_rerequested", statestats.nBlocksReRequested));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
@@ -381,6 +393,16 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
             "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
             "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
             "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"relaycache\":\n"
+            "  {\n"
+            "    \"entries\": n,       (numeric) Number of relayed messages kept to answer getdata requests\n"
+            "    \"bytes\": n,         (numeric) Estimated memory used by the cached messages\n"
+            "    \"limit\": n,         (numeric) Maximum memory the cache may use (-maxrelaycache)\n"
+            "    \"hits\": n,          (numeric) Number of getdata requests answered from the cache\n"
+            "    \"misses\": n,        (numeric) Number of getdata lookups not found in the cache\n"
+            "    \"evictions\": n,     (numeric) Number of messages dropped to stay within the limit\n"
+            "    \"expirations\": n    (numeric) Number of messages dropped after their relay time ran out\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -401,6 +423,17 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     outboundLimit.push_back(Pair("bytes_left_in_cycle", CNode::GetOutboundTargetBytesLeft()));
     outboundLimit.push_back(Pair("time_left_in_cycle", CNode::GetMaxOutboundTimeLeftInCycle()));
     obj.push_back(Pair("uploadtarget", outboundLimit));
+
+    CRelayCacheStats relayStats = relaycache.GetStats();
+    UniValue relayCacheObj(UniValue::VOBJ);
+    relayCacheObj.push_back(Pair("entries", (uint64_t)relayStats.nEntries));
+    relayCacheObj.push_back(Pair("bytes", (uint64_t)relayStats.nBytes));
+    relayCacheObj.push_back(Pair("limit", (uint64_t)relayStats.nMaxBytes));
+    relayCacheObj.push_back(Pair("hits", relayStats.nHits));
+    relayCacheObj.push_back(Pair("misses", relayStats.nMisses));
+    relayCacheObj.push_back(Pair("evictions", relayStats.nEvictions));
+    relayCacheObj.push_back(Pair("expirations", relayStats.nExpirations));
+    obj.push_back(Pair("relaycache", relayCacheObj));
     return obj;
 }
 
@@ -352,6 +352,7 @@ static const CRPCCommand vRPCCommands[] =
     { "reef",               "getsuperblockbudget",    &getsuperblockbudget,    true  },
     { "reef",               "voteraw",                &voteraw,                true  },
     { "reef",               "mnsync",                 &mnsync,                 true  },
+    { "reef",               "getcachedumpinfo",       &getcachedumpinfo,       true  },
     { "reef",               "spork",                  &spork,                  true  },
     { "reef",               "getpoolinfo",            &getpoolinfo,            true  },
 #ifdef ENABLE_WALLET
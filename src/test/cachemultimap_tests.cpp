@@ -171,6 +171,15 @@ BOOST_AUTO_TEST_CASE(cachemultimap_test)
     CacheMultiMap<int,int> mapTest4;
     mapTest4 = mapTest1;
     BOOST_CHECK(Compare(mapTest1, mapTest4));
+
+    // copies index their own items and outlive the original
+    mapTest1.Clear();
+    std::vector<int> vecVals3;
+    BOOST_CHECK(mapTest3.GetAll(5, vecVals3) == true);
+    BOOST_CHECK(vecVals3.size() == 3);
+    mapTest4.Erase(5);
+    BOOST_CHECK(mapTest4.HasKey(5) == false);
+    BOOST_CHECK(mapTest4.GetSize() == 7);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
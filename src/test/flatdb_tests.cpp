@@ -0,0 +1,137 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "flat-database.h"
+#include "netfulfilledman.h"
+
+#include "test/test_reef.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(flatdb_tests, BasicTestingSetup)
+
+struct CSectionedObject
+{
+    std::map<int, std::string> mapFirst;
+    std::vector<int> vecSecond;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(FLATDB_SECTION(mapFirst));
+        READWRITE(FLATDB_SECTION(vecSecond));
+    }
+};
+
+// both members have to be loaded, or the object is cleared
+struct CDependentSectionsObject : public CSectionedObject
+{
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        bool fDamaged = false;
+        READWRITE(FLATDB_SECTION_CHECKED(mapFirst, fDamaged));
+        READWRITE(FLATDB_SECTION_CHECKED(vecSecond, fDamaged));
+        if(ser_action.ForRead() && fDamaged) {
+            mapFirst.clear();
+            vecSecond.clear();
+        }
+    }
+};
+
+static CSectionedObject MakeObject()
+{
+    CSectionedObject obj;
+    obj.mapFirst[1] = "one";
+    obj.mapFirst[2] = "two";
+    obj.vecSecond.push_back(3);
+    obj.vecSecond.push_back(4);
+    return obj;
+}
+
+BOOST_AUTO_TEST_CASE(flatdb_section_roundtrip)
+{
+    CSectionedObject obj = MakeObject();
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << obj;
+    BOOST_CHECK_EQUAL(ss.size(), obj.GetSerializeSize(SER_DISK, CLIENT_VERSION));
+
+    CSectionedObject objLoaded;
+    ss >> objLoaded;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK(objLoaded.mapFirst == obj.mapFirst);
+    BOOST_CHECK(objLoaded.vecSecond == obj.vecSecond);
+}
+
+BOOST_AUTO_TEST_CASE(flatdb_section_skip_damaged)
+{
+    CSectionedObject obj = MakeObject();
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << obj;
+
+    // flip a byte of the first section's data, right after its size
+    ss[sizeof(uint64_t) + 1] ^= 0x01;
+
+    CSectionedObject objLoaded;
+    objLoaded.mapFirst[5] = "untouched";
+    ss >> objLoaded;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK_EQUAL(objLoaded.mapFirst.size(), 1U);
+    BOOST_CHECK_EQUAL(objLoaded.mapFirst[5], "untouched");
+    BOOST_CHECK(objLoaded.vecSecond == obj.vecSecond);
+}
+
+BOOST_AUTO_TEST_CASE(flatdb_section_damaged_dependent)
+{
+    CDependentSectionsObject obj;
+    static_cast<CSectionedObject&>(obj) = MakeObject();
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << obj;
+    CDataStream ssDamaged(ss);
+
+    CDependentSectionsObject objLoaded;
+    ss >> objLoaded;
+    BOOST_CHECK(objLoaded.mapFirst == obj.mapFirst);
+    BOOST_CHECK(objLoaded.vecSecond == obj.vecSecond);
+
+    // the second section still verifies, but is dropped along with the first one
+    ssDamaged[sizeof(uint64_t) + 1] ^= 0x01;
+    CDependentSectionsObject objDamaged;
+    ssDamaged >> objDamaged;
+    BOOST_CHECK(ssDamaged.empty());
+    BOOST_CHECK(objDamaged.mapFirst.empty());
+    BOOST_CHECK(objDamaged.vecSecond.empty());
+}
+
+BOOST_AUTO_TEST_CASE(flatdb_generation_follows_changes)
+{
+    CNetFulfilledRequestManager fulfilledman;
+    CAddress addr(CService("1.2.3.4", 5678), NODE_NETWORK);
+
+    uint64_t nGeneration = fulfilledman.GetCacheGeneration();
+    fulfilledman.AddFulfilledRequest(addr, "request");
+    BOOST_CHECK(fulfilledman.GetCacheGeneration() != nGeneration);
+
+    // lookups and removing what isn't there leave it alone
+    nGeneration = fulfilledman.GetCacheGeneration();
+    BOOST_CHECK(fulfilledman.HasFulfilledRequest(addr, "request"));
+    fulfilledman.RemoveFulfilledRequest(addr, "other");
+    fulfilledman.CheckAndRemove();
+    BOOST_CHECK_EQUAL(fulfilledman.GetCacheGeneration(), nGeneration);
+
+    // the copy written is what gets loaded
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << fulfilledman;
+    CNetFulfilledRequestManager fulfilledmanLoaded;
+    ss >> fulfilledmanLoaded;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK(fulfilledmanLoaded.HasFulfilledRequest(addr, "request"));
+
+    fulfilledman.RemoveFulfilledRequest(addr, "request");
+    BOOST_CHECK(fulfilledman.GetCacheGeneration() != nGeneration);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,271 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance.h"
+#include "governance-object.h"
+#include "governance-votedb.h"
+#include "masternodeman.h"
+#include "random.h"
+
+#include "test/test_reef.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_tests, BasicTestingSetup)
+
+static const int signals[] = {VOTE_SIGNAL_FUNDING, VOTE_SIGNAL_VALID, VOTE_SIGNAL_DELETE, VOTE_SIGNAL_ENDORSED};
+static const int outcomes[] = {VOTE_OUTCOME_NONE, VOTE_OUTCOME_YES, VOTE_OUTCOME_NO, VOTE_OUTCOME_ABSTAIN};
+
+static CGovernanceObject::vote_m_t MakeRandomVotes(int nMasternodes)
+{
+    CGovernanceObject::vote_m_t mapVotes;
+    for(int i = 0; i < nMasternodes; i++) {
+        vote_rec_t recVote;
+        for(size_t j = 0; j < ARRAYLEN(signals); j++) {
+            if(GetRandInt(3) == 0) continue;
+            vote_outcome_enum_t eOutcome = vote_outcome_enum_t(outcomes[GetRandInt(ARRAYLEN(outcomes))]);
+            recVote.mapInstances[signals[j]] = vote_instance_t(eOutcome, GetRandInt(1000), GetRandInt(1000));
+        }
+        mapVotes[i] = recVote;
+    }
+    return mapVotes;
+}
+
+// the tallies the way they used to be calculated, by going through every vote
+static int RecountVotes(const CGovernanceObject::vote_m_t& mapVotes, int nSignal, int nOutcome)
+{
+    int nCount = 0;
+    for(CGovernanceObject::vote_m_cit it = mapVotes.begin(); it != mapVotes.end(); ++it) {
+        vote_instance_m_cit it2 = it->second.mapInstances.find(nSignal);
+        if(it2 != it->second.mapInstances.end() && it2->second.eOutcome == nOutcome) {
+            ++nCount;
+        }
+    }
+    return nCount;
+}
+
+static void LoadObject(CGovernanceObject& govobj, const CGovernanceObject::vote_m_t& mapVotes)
+{
+    // disk format of an object, see CGovernanceObject::SerializationOp
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << uint256() << 1 << GetTime() << uint256() << std::string() << (int)GOVERNANCE_OBJECT_UNKNOWN;
+    ss << CTxIn() << std::vector<unsigned char>();
+    ss << (int64_t)0 << false << mapVotes << CGovernanceObjectVoteFile();
+    ss >> govobj;
+}
+
+static void CheckVoteCounts(const CGovernanceObject& govobj, const CGovernanceObject::vote_m_t& mapVotes)
+{
+    for(size_t i = 0; i < ARRAYLEN(signals); i++) {
+        vote_signal_enum_t eSignal = vote_signal_enum_t(signals[i]);
+        for(size_t j = 0; j < ARRAYLEN(outcomes); j++) {
+            BOOST_CHECK_EQUAL(govobj.CountMatchingVotes(eSignal, vote_outcome_enum_t(outcomes[j])), RecountVotes(mapVotes, signals[i], outcomes[j]));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(governance_vote_counts_match_recount)
+{
+    CGovernanceObject::vote_m_t mapVotes = MakeRandomVotes(500);
+    CGovernanceObject govobj;
+    LoadObject(govobj, mapVotes);
+
+    for(size_t i = 0; i < ARRAYLEN(signals); i++) {
+        vote_signal_enum_t eSignal = vote_signal_enum_t(signals[i]);
+        for(size_t j = 0; j < ARRAYLEN(outcomes); j++) {
+            BOOST_CHECK_EQUAL(govobj.CountMatchingVotes(eSignal, vote_outcome_enum_t(outcomes[j])), RecountVotes(mapVotes, signals[i], outcomes[j]));
+        }
+        int nYes = RecountVotes(mapVotes, signals[i], VOTE_OUTCOME_YES);
+        int nNo = RecountVotes(mapVotes, signals[i], VOTE_OUTCOME_NO);
+        BOOST_CHECK_EQUAL(govobj.GetYesCount(eSignal), nYes);
+        BOOST_CHECK_EQUAL(govobj.GetNoCount(eSignal), nNo);
+        BOOST_CHECK_EQUAL(govobj.GetAbstainCount(eSignal), RecountVotes(mapVotes, signals[i], VOTE_OUTCOME_ABSTAIN));
+        BOOST_CHECK_EQUAL(govobj.GetAbsoluteYesCount(eSignal), nYes - nNo);
+    }
+
+    // a copy keeps the tallies
+    CGovernanceObject govobjCopy(govobj);
+    BOOST_CHECK_EQUAL(govobjCopy.GetYesCount(VOTE_SIGNAL_FUNDING), RecountVotes(mapVotes, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+}
+
+BOOST_AUTO_TEST_CASE(governance_vote_counts_follow_votes)
+{
+    CGovernanceVoteDB votedb(1 << 20, true);
+    pgovernancevotedb = &votedb;
+
+    // masternodes voting on the object, the object also has votes of masternodes we don't know
+    static const int nMasternodes = 10;
+    std::vector<CKey> vKeys;
+    std::vector<CTxIn> vVins;
+    std::set<int> setKnownIndexes;
+    for(int i = 0; i < nMasternodes; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        struct in_addr ip;
+        ip.s_addr = htonl(0x01000000 | i);
+        CTxIn vin(COutPoint(GetRandHash(), 0));
+        CMasternode mn(CService(CNetAddr(ip), 9857), vin, key.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION);
+        BOOST_CHECK(mnodeman.Add(mn));
+        vKeys.push_back(key);
+        vVins.push_back(vin);
+        setKnownIndexes.insert(mnodeman.GetMasternodeIndex(vin));
+    }
+    CGovernanceObject::vote_m_t mapVotes = MakeRandomVotes(nMasternodes + 50);
+    BOOST_CHECK_EQUAL(setKnownIndexes.size(), (size_t)nMasternodes);
+    for(std::set<int>::const_iterator it = setKnownIndexes.begin(); it != setKnownIndexes.end(); ++it) {
+        BOOST_CHECK(mapVotes.count(*it));
+        // one outcome to change and one instance to add per masternode
+        mapVotes[*it].mapInstances[VOTE_SIGNAL_FUNDING] = vote_instance_t(VOTE_OUTCOME_YES, 0, 0);
+        mapVotes[*it].mapInstances.erase(VOTE_SIGNAL_DELETE);
+    }
+
+    CGovernanceObject govobjLoaded;
+    LoadObject(govobjLoaded, mapVotes);
+    uint256 nHash = govobjLoaded.GetHash();
+
+    // a manager holding the object, in its disk format, see CGovernanceManager::SerializationOp
+    std::string strVersion;
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << CGovernanceManager();
+        ss >> FLATDB_SECTION(strVersion);
+    }
+    CGovernanceManager::count_m_t mapSeen;
+    CGovernanceManager::vote_cache_t mapInvalid;
+    CGovernanceManager::vote_mcache_t mapOrphan;
+    CGovernanceManager::object_m_t mapObjects;
+    CGovernanceManager::hash_time_m_t mapWatchdog;
+    uint256 nHashWatchdog;
+    int64_t nTimeWatchdog = 0;
+    CGovernanceManager::txout_m_t mapLastObject;
+    mapObjects.insert(std::make_pair(nHash, govobjLoaded));
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << FLATDB_SECTION(strVersion) << FLATDB_SECTION(mapSeen) << FLATDB_SECTION(mapInvalid) << FLATDB_SECTION(mapOrphan);
+    ss << FLATDB_SECTION(mapObjects) << FLATDB_SECTION(mapWatchdog) << FLATDB_SECTION(nHashWatchdog);
+    ss << FLATDB_SECTION(nTimeWatchdog) << FLATDB_SECTION(mapLastObject);
+    CGovernanceManager govman;
+    ss >> govman;
+    CGovernanceObject* pgovobj = govman.FindGovernanceObject(nHash);
+    BOOST_REQUIRE(pgovobj != NULL);
+    CheckVoteCounts(*pgovobj, mapVotes);
+
+    uint256 nHashLastVote;
+    for(int i = 0; i < nMasternodes; i++) {
+        int nIndex = mnodeman.GetMasternodeIndex(vVins[i]);
+        vote_outcome_enum_t eOutcome = i % 2 ? VOTE_OUTCOME_NO : VOTE_OUTCOME_ABSTAIN;
+        CGovernanceException exception;
+
+        CGovernanceVote voteChange(vVins[i], nHash, VOTE_SIGNAL_FUNDING, eOutcome);
+        CPubKey pubKey = vKeys[i].GetPubKey();
+        BOOST_CHECK(voteChange.Sign(vKeys[i], pubKey));
+        BOOST_CHECK(govman.ProcessVoteAndRelay(voteChange, exception));
+        mapVotes[nIndex].mapInstances[VOTE_SIGNAL_FUNDING].eOutcome = eOutcome;
+        CheckVoteCounts(*pgovobj, mapVotes);
+
+        CGovernanceVote voteNew(vVins[i], nHash, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_YES);
+        BOOST_CHECK(voteNew.Sign(vKeys[i], pubKey));
+        BOOST_CHECK(govman.ProcessVoteAndRelay(voteNew, exception));
+        mapVotes[nIndex].mapInstances[VOTE_SIGNAL_DELETE] = vote_instance_t(VOTE_OUTCOME_YES, 0, 0);
+        CheckVoteCounts(*pgovobj, mapVotes);
+        nHashLastVote = voteNew.GetHash();
+    }
+
+    // a manager loaded from the cache finds the votes in the store without reading them all at startup
+    {
+        CDataStream ssCache(SER_DISK, CLIENT_VERSION);
+        ssCache << govman;
+        CGovernanceManager govmanLoaded;
+        ssCache >> govmanLoaded;
+        govmanLoaded.InitOnLoad();
+        BOOST_CHECK_EQUAL(govmanLoaded.GetVoteCount(), 0);
+        BOOST_CHECK(govmanLoaded.HaveVoteForHash(nHashLastVote));
+        BOOST_CHECK_EQUAL(govmanLoaded.GetVoteCount(), 1);
+        BOOST_CHECK(!govmanLoaded.HaveVoteForHash(GetRandHash()));
+    }
+
+    // the records of masternodes we don't know are dropped
+    mnodeman.AddDirtyGovernanceObjectHash(nHash);
+    govman.UpdateCachesAndClean();
+    CGovernanceObject::vote_m_it it = mapVotes.begin();
+    while(it != mapVotes.end()) {
+        if(setKnownIndexes.count(it->first)) {
+            ++it;
+        } else {
+            mapVotes.erase(it++);
+        }
+    }
+    CheckVoteCounts(*pgovobj, mapVotes);
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_DELETE), nMasternodes);
+
+    mnodeman.Clear();
+    pgovernancevotedb = NULL;
+}
+
+BOOST_AUTO_TEST_CASE(governance_vote_file_store)
+{
+    CGovernanceVoteDB votedb(1 << 20, true);
+    pgovernancevotedb = &votedb;
+
+    uint256 nParentHash = GetRandHash();
+    CTxIn vin1(COutPoint(GetRandHash(), 0));
+    CTxIn vin2(COutPoint(GetRandHash(), 1));
+    CGovernanceVote vote1(vin1, nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    CGovernanceVote vote2(vin1, nParentHash, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_NO);
+    CGovernanceVote vote3(vin2, nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO);
+    // a vote of another object
+    CGovernanceVote vote4(vin2, GetRandHash(), VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO);
+
+    CGovernanceObjectVoteFile fileVotes;
+    BOOST_CHECK(!fileVotes.HasVote(vote1.GetHash()));
+    fileVotes.AddVote(vote1);
+    fileVotes.AddVote(vote2);
+    fileVotes.AddVote(vote3);
+    BOOST_CHECK(votedb.WriteVotes(std::vector<CGovernanceVote>(1, vote4)));
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 3);
+    BOOST_CHECK_EQUAL(fileVotes.GetVotes().size(), 3U);
+    BOOST_CHECK(fileVotes.HasVote(vote2.GetHash()));
+    BOOST_CHECK(!fileVotes.HasVote(vote4.GetHash()));
+
+    // the object of a vote is found from the vote's hash alone
+    uint256 nParentHashRead;
+    BOOST_CHECK(votedb.ReadVoteParent(vote2.GetHash(), nParentHashRead));
+    BOOST_CHECK(nParentHashRead == nParentHash);
+    BOOST_CHECK(votedb.ReadVoteParent(vote4.GetHash(), nParentHashRead));
+    BOOST_CHECK(nParentHashRead == vote4.GetParentHash());
+
+    // only the number of votes is written with the object
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << fileVotes;
+    CGovernanceObjectVoteFile fileVotesLoaded;
+    ss >> fileVotesLoaded;
+    BOOST_CHECK_EQUAL(fileVotesLoaded.GetVoteCount(), 3);
+    CGovernanceVote voteRead;
+    BOOST_CHECK(fileVotesLoaded.GetVote(vote3.GetHash(), voteRead));
+    BOOST_CHECK(voteRead.GetHash() == vote3.GetHash());
+
+    fileVotes.RemoveVotesFromMasternode(vin1);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 1);
+    BOOST_CHECK(!fileVotes.HasVote(vote1.GetHash()));
+    BOOST_CHECK(fileVotes.HasVote(vote3.GetHash()));
+    BOOST_CHECK(!votedb.ReadVoteParent(vote1.GetHash(), nParentHashRead));
+
+    std::set<uint256> setHashes;
+    BOOST_CHECK(votedb.ReadObjectHashes(setHashes));
+    BOOST_CHECK_EQUAL(setHashes.size(), 2U);
+    BOOST_CHECK(setHashes.count(nParentHash));
+    BOOST_CHECK(setHashes.count(vote4.GetParentHash()));
+
+    fileVotes.RemoveAllVotes();
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 0);
+    std::vector<CGovernanceVote> vecVotes;
+    BOOST_CHECK(votedb.ReadVotes(nParentHash, vecVotes));
+    BOOST_CHECK(vecVotes.empty());
+    BOOST_CHECK(!votedb.ReadVoteParent(vote3.GetHash(), nParentHashRead));
+    BOOST_CHECK(votedb.ReadVotes(vote4.GetParentHash(), vecVotes));
+    BOOST_CHECK_EQUAL(vecVotes.size(), 1U);
+
+    pgovernancevotedb = NULL;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
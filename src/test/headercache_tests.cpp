@@ -0,0 +1,115 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "headercache.h"
+#include "random.h"
+
+#include "test/test_reef.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(headercache_tests, BasicTestingSetup)
+
+// Build a chain of nLength blocks on top of pindexBase, the entries must outlive their use
+static void BuildChain(CBlockIndex* pindexBase, int nLength, std::vector<uint256>& vHashes, std::vector<CBlockIndex>& vBlocks)
+{
+    vHashes.resize(nLength);
+    vBlocks.resize(nLength);
+    for (int i = 0; i < nLength; i++) {
+        vHashes[i] = GetRandHash();
+        vBlocks[i].phashBlock = &vHashes[i];
+        vBlocks[i].pprev = i > 0 ? &vBlocks[i - 1] : pindexBase;
+        vBlocks[i].nHeight = pindexBase ? pindexBase->nHeight + 1 + i : i;
+        vBlocks[i].nTime = 1500000000 + vBlocks[i].nHeight;
+        vBlocks[i].nVersion = 4;
+    }
+}
+
+static std::vector<CBlock> ReadHeaders(CDataStream& ss)
+{
+    std::vector<CBlock> vHeaders;
+    ss >> vHeaders;
+    BOOST_CHECK(ss.empty());
+    return vHeaders;
+}
+
+static CBlockLocator Locator(const CBlockIndex* pindex)
+{
+    std::vector<uint256> vHave(1, pindex->GetBlockHash());
+    return CBlockLocator(vHave);
+}
+
+BOOST_AUTO_TEST_CASE(headercache_getheaders)
+{
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vBlocks;
+    BuildChain(NULL, 100, vHashes, vBlocks);
+
+    CHeaderCache cache;
+    cache.SetTip(&vBlocks[99]);
+    BOOST_CHECK_EQUAL(cache.Height(), 99);
+
+    // everything after the locator, limited
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(cache.GetHeaders(Locator(&vBlocks[10]), uint256(), 20, ss) == &vBlocks[30]);
+    std::vector<CBlock> vHeaders = ReadHeaders(ss);
+    BOOST_CHECK_EQUAL(vHeaders.size(), 20U);
+    for (size_t i = 0; i < vHeaders.size(); i++) {
+        BOOST_CHECK(vHeaders[i].nTime == vBlocks[11 + i].nTime);
+        BOOST_CHECK(vHeaders[i].vtx.empty());
+    }
+
+    // stop hash is included
+    BOOST_CHECK(cache.GetHeaders(Locator(&vBlocks[10]), vHashes[15], 2000, ss) == &vBlocks[15]);
+    BOOST_CHECK_EQUAL(ReadHeaders(ss).size(), 5U);
+
+    // unknown locator starts after genesis, caller at the tip gets nothing
+    CBlockLocator locatorUnknown(std::vector<uint256>(1, GetRandHash()));
+    BOOST_CHECK(cache.GetHeaders(locatorUnknown, uint256(), 2000, ss) == &vBlocks[99]);
+    BOOST_CHECK_EQUAL(ReadHeaders(ss).size(), 99U);
+    BOOST_CHECK(cache.GetHeaders(Locator(&vBlocks[99]), uint256(), 2000, ss) == NULL);
+    BOOST_CHECK_EQUAL(ReadHeaders(ss).size(), 0U);
+
+    // getblocks doesn't include the stop hash
+    std::vector<CBlockIndex*> vRet;
+    cache.GetBlocks(Locator(&vBlocks[10]), vHashes[15], 500, vRet);
+    BOOST_CHECK_EQUAL(vRet.size(), 4U);
+    BOOST_CHECK(vRet.front() == &vBlocks[11] && vRet.back() == &vBlocks[14]);
+}
+
+BOOST_AUTO_TEST_CASE(headercache_reorg)
+{
+    std::vector<uint256> vHashes, vHashesFork;
+    std::vector<CBlockIndex> vBlocks, vBlocksFork;
+    BuildChain(NULL, 100, vHashes, vBlocks);
+    BuildChain(&vBlocks[49], 60, vHashesFork, vBlocksFork);
+
+    CHeaderCache cache;
+    cache.SetTip(&vBlocks[99]);
+    size_t nUsage = cache.DynamicMemoryUsage();
+
+    // switch to the longer fork, blocks of the old branch are no longer found
+    cache.SetTip(&vBlocksFork[59]);
+    BOOST_CHECK_EQUAL(cache.Height(), 109);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(cache.GetHeaders(Locator(&vBlocks[80]), uint256(), 2000, ss) == &vBlocksFork[59]);
+    BOOST_CHECK_EQUAL(ReadHeaders(ss).size(), 109U);
+    BOOST_CHECK(cache.GetHeaders(Locator(&vBlocks[40]), uint256(), 2000, ss) == &vBlocksFork[59]);
+    BOOST_CHECK_EQUAL(ReadHeaders(ss).size(), 69U);
+
+    // disconnecting blocks one by one
+    cache.SetTip(&vBlocksFork[58]);
+    cache.SetTip(&vBlocks[49]);
+    BOOST_CHECK_EQUAL(cache.Height(), 49);
+    BOOST_CHECK(cache.DynamicMemoryUsage() <= nUsage);
+    BOOST_CHECK(cache.GetHeaders(Locator(&vBlocksFork[0]), uint256(), 2000, ss) == &vBlocks[49]);
+    BOOST_CHECK_EQUAL(ReadHeaders(ss).size(), 49U);
+
+    cache.SetTip(NULL);
+    BOOST_CHECK_EQUAL(cache.Height(), -1);
+    BOOST_CHECK(cache.GetHeaders(Locator(&vBlocks[10]), uint256(), 2000, ss) == NULL);
+    BOOST_CHECK_EQUAL(ReadHeaders(ss).size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,90 @@
+// Copyright (c) 2018 The Reef Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "iblt.h"
+#include "random.h"
+#include "streams.h"
+#include "uint256.h"
+
+#include "test/test_reef.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(iblt_tests, BasicTestingSetup)
+
+// two sets sharing nCommon keys, with nOnlyA and nOnlyB keys of their own
+static void Reconcile(unsigned int nCells, int nCommon, int nOnlyA, int nOnlyB, bool& fDecodedRet, std::set<uint64_t>& setOnlyA, std::set<uint64_t>& setOnlyB)
+{
+    uint64_t nSalt = GetRand(std::numeric_limits<uint64_t>::max());
+    CInvertibleBloomLookupTable tableA(nCells, nSalt);
+    CInvertibleBloomLookupTable tableB(nCells, nSalt);
+
+    for(int i = 0; i < nCommon; i++) {
+        uint256 hash = GetRandHash();
+        tableA.insert(hash);
+        tableB.insert(hash);
+    }
+    for(int i = 0; i < nOnlyA; i++) {
+        uint256 hash = GetRandHash();
+        setOnlyA.insert(tableA.GetShortId(hash));
+        tableA.insert(hash);
+    }
+    for(int i = 0; i < nOnlyB; i++) {
+        uint256 hash = GetRandHash();
+        setOnlyB.insert(tableB.GetShortId(hash));
+        tableB.insert(hash);
+    }
+
+    // what a peer would receive
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tableB;
+    CInvertibleBloomLookupTable tableReceived;
+    ss >> tableReceived;
+    BOOST_CHECK(tableReceived.IsWithinSizeConstraints());
+
+    std::set<uint64_t> setPositive, setNegative;
+    BOOST_CHECK(tableA.Subtract(tableReceived));
+    fDecodedRet = tableA.Decode(setPositive, setNegative);
+    if(fDecodedRet) {
+        BOOST_CHECK(setPositive == setOnlyA);
+        BOOST_CHECK(setNegative == setOnlyB);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(iblt_decodes_small_difference)
+{
+    std::set<uint64_t> setOnlyA, setOnlyB;
+    bool fDecoded = false;
+    // the size of the sets doesn't matter, only their difference
+    Reconcile(300, 5000, 5, 5, fDecoded, setOnlyA, setOnlyB);
+    BOOST_CHECK(fDecoded);
+
+    setOnlyA.clear();
+    setOnlyB.clear();
+    Reconcile(300, 100, 0, 0, fDecoded, setOnlyA, setOnlyB);
+    BOOST_CHECK(fDecoded);
+}
+
+BOOST_AUTO_TEST_CASE(iblt_fails_on_large_difference)
+{
+    std::set<uint64_t> setOnlyA, setOnlyB;
+    bool fDecoded = true;
+    Reconcile(48, 100, 200, 200, fDecoded, setOnlyA, setOnlyB);
+    BOOST_CHECK(!fDecoded);
+}
+
+BOOST_AUTO_TEST_CASE(iblt_size_constraints)
+{
+    BOOST_CHECK(!CInvertibleBloomLookupTable().IsWithinSizeConstraints());
+    BOOST_CHECK_EQUAL(CInvertibleBloomLookupTable(10, 0).size(), 12U);
+    BOOST_CHECK(CInvertibleBloomLookupTable(MAX_IBLT_CELLS, 0).IsWithinSizeConstraints());
+    BOOST_CHECK(!CInvertibleBloomLookupTable(MAX_IBLT_CELLS + 1, 0).IsWithinSizeConstraints());
+
+    // tables of a different size or salt can't be subtracted
+    CInvertibleBloomLookupTable table(48, 1);
+    BOOST_CHECK(!table.Subtract(CInvertibleBloomLookupTable(48, 2)));
+    BOOST_CHECK(!table.Subtract(CInvertibleBloomLookupTable(51, 1)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,106 @@
+// Copyright (c) 2018 The Reef Core developers
+
+#include "relaycache.h"
+#include "random.h"
+#include "utiltime.h"
+
+#include "test/test_reef.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(relaycache_tests, BasicTestingSetup)
+
+static CDataStream MakeMessage(size_t nSize)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.reserve(10000);
+    std::vector<unsigned char> vch(nSize, 0x5a);
+    ss.write((const char*)&vch[0], vch.size());
+    return ss;
+}
+
+BOOST_AUTO_TEST_CASE(relaycache_insert_get)
+{
+    CRelayCache cache;
+    CInv inv(MSG_TX, GetRandHash());
+    CInv invOther(MSG_TX, GetRandHash());
+
+    cache.Insert(inv, MakeMessage(250));
+    BOOST_CHECK(cache.Has(inv));
+    BOOST_CHECK(!cache.Has(invOther));
+    // same hash, different type is a different entry
+    BOOST_CHECK(!cache.Has(CInv(MSG_DSTX, inv.hash)));
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(cache.Get(inv, ss));
+    BOOST_CHECK_EQUAL(ss.size(), 250U);
+    BOOST_CHECK(!cache.Get(invOther, ss));
+
+    CRelayCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nEntries, 1U);
+    BOOST_CHECK_EQUAL(stats.nHits, 1U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 1U);
+    // the over-reserved stream must not be accounted for
+    BOOST_CHECK(stats.nBytes < 1000);
+
+    // replacing keeps a single entry
+    cache.Insert(inv, MakeMessage(100));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 1U);
+    CDataStream ss2(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(cache.Get(inv, ss2));
+    BOOST_CHECK_EQUAL(ss2.size(), 100U);
+
+    cache.Clear();
+    BOOST_CHECK(!cache.Has(inv));
+    BOOST_CHECK_EQUAL(cache.GetStats().nBytes, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(relaycache_expiration)
+{
+    int64_t nStartTime = GetTime();
+    SetMockTime(nStartTime);
+
+    CRelayCache cache;
+    CInv invTx(MSG_TX, GetRandHash());
+    CInv invDstx(MSG_DSTX, GetRandHash());
+    cache.Insert(invTx, MakeMessage(200));
+    cache.Insert(invDstx, MakeMessage(200));
+
+    SetMockTime(nStartTime + GetRelayCacheTTL(MSG_DSTX) + 1);
+    BOOST_CHECK(cache.Has(invTx));
+    BOOST_CHECK(!cache.Has(invDstx));
+
+    SetMockTime(nStartTime + GetRelayCacheTTL(MSG_TX) + 1);
+    BOOST_CHECK(!cache.Has(invTx));
+
+    cache.Expire();
+    CRelayCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nEntries, 0U);
+    BOOST_CHECK_EQUAL(stats.nBytes, 0U);
+    BOOST_CHECK_EQUAL(stats.nExpirations, 2U);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(relaycache_byte_budget)
+{
+    CRelayCache cache;
+    size_t nMaxBytes = RELAY_CACHE_SHARDS * 10 * 1000;
+    cache.SetMaxSize(nMaxBytes);
+
+    for(int i = 0; i < 2000; i++) {
+        cache.Insert(CInv(MSG_TX, GetRandHash()), MakeMessage(500));
+    }
+
+    CRelayCacheStats stats = cache.GetStats();
+    BOOST_CHECK(stats.nBytes <= nMaxBytes);
+    BOOST_CHECK(stats.nEvictions > 0);
+    BOOST_CHECK_EQUAL(stats.nEntries + stats.nEvictions, 2000U);
+
+    // messages larger than a shard are not kept at all
+    CInv invHuge(MSG_TX, GetRandHash());
+    cache.Insert(invHuge, MakeMessage(nMaxBytes));
+    BOOST_CHECK(!cache.Has(invHuge));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
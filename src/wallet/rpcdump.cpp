@@ -141,6 +141,10 @@ UniValue importprivkey(const UniValue& params, bool fHelp)
         if (!pwalletMain->AddKeyPubKey(key, pubkey))
             throw JSONRPCError(RPC_WALLET_ERROR, "Error adding key to wallet");
 
+        // inputs of existing transactions may be ours now
+        pwalletMain->ClearPrivateSendRounds();
+        pwalletMain->ReindexCoins();
+
         // whenever a key is imported, we need to scan the whole chain
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
 
@@ -163,6 +167,9 @@ void ImportScript(const CScript& script, const string& strLabel, bool isRedeemSc
     if (!pwalletMain->HaveWatchOnly(script) && !pwalletMain->AddWatchOnly(script))
         throw JSONRPCError(RPC_WALLET_ERROR, "Error adding address to wallet");
 
+    pwalletMain->ClearPrivateSendRounds();
+    pwalletMain->ReindexCoins();
+
     if (isRedeemScript) {
         if (!pwalletMain->HaveCScript(script) && !pwalletMain->AddCScript(script))
             throw JSONRPCError(RPC_WALLET_ERROR, "Error adding p2sh redeemScript to wallet");
@@ -400,6 +407,9 @@ UniValue importwallet(const UniValue& params, bool fHelp)
     if (!pwalletMain->nTimeFirstKey || nTimeBegin < pwalletMain->nTimeFirstKey)
         pwalletMain->nTimeFirstKey = nTimeBegin;
 
+    pwalletMain->ClearPrivateSendRounds();
+    pwalletMain->ReindexCoins();
+
     LogPrintf("Rescanning last %i blocks\n", chainActive.Height() - pindex->nHeight + 1);
     pwalletMain->ScanForWalletTransactions(pindex);
     pwalletMain->MarkDirty();
@@ -535,6 +545,9 @@ UniValue importelectrumwallet(const UniValue& params, bool fHelp)
     if (!pwalletMain->nTimeFirstKey || nTimeBegin < pwalletMain->nTimeFirstKey)
         pwalletMain->nTimeFirstKey = nTimeBegin;
 
+    pwalletMain->ClearPrivateSendRounds();
+    pwalletMain->ReindexCoins();
+
     LogPrintf("Rescanning %i blocks\n", chainActive.Height() - nStartHeight + 1);
     pwalletMain->ScanForWalletTransactions(chainActive[nStartHeight], true);
 
@@ -1176,6 +1176,8 @@ UniValue addmultisigaddress(const UniValue& params, bool fHelp)
     CScript inner = _createmultisig_redeemScript(params);
     CScriptID innerID(inner);
     pwalletMain->AddCScript(inner);
+    // outputs to it may be ours now
+    pwalletMain->ReindexCoins();
 
     pwalletMain->SetAddressBook(innerID, strAccount, "send");
     return CBitcoinAddress(innerID).ToString();
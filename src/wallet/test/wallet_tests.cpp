@@ -4,6 +4,9 @@
 
 #include "wallet/wallet.h"
 
+#include "darksend.h"
+#include "wallet/walletdb.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -23,6 +26,8 @@
 
 using namespace std;
 
+extern CWallet* pwalletMain;
+
 typedef set<pair<const CWalletTx*,unsigned int> > CoinSet;
 
 BOOST_FIXTURE_TEST_SUITE(wallet_tests, TestingSetup)
@@ -361,4 +366,105 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 101);
 }
 
+BOOST_AUTO_TEST_CASE(privatesend_rounds_cache)
+{
+    darkSendPool.InitDenominations();
+    CAmount nDenom = vecPrivateSendDenominations[1];
+
+    LOCK(pwalletMain->cs_wallet);
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(pwalletMain->AddKeyPubKey(key, key.GetPubKey()));
+    CScript script = GetScriptForDestination(key.GetPubKey().GetID());
+
+    // a denomination paid to us from inputs which aren't ours
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vout.push_back(CTxOut(nDenom, script));
+
+    // the next round spending it
+    CMutableTransaction txChild;
+    txChild.vin.push_back(CTxIn(txParent.GetHash(), 0));
+    txChild.vout.push_back(CTxOut(nDenom, script));
+    txChild.vout.push_back(CTxOut(nDenom, script));
+
+    // without its parent the child looks like a first round
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, txChild), false, &walletdb));
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(CTxIn(txChild.GetHash(), 0), 0), 0);
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(CTxIn(txChild.GetHash(), 1), 0), 0);
+
+    // the cached rounds of the child are dropped once the parent shows up
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, txParent), false, &walletdb));
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(CTxIn(txParent.GetHash(), 0), 0), 0);
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(CTxIn(txChild.GetHash(), 0), 0), 1);
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(CTxIn(txChild.GetHash(), 1), 0), 1);
+
+    // non-denominated outputs
+    CMutableTransaction txOther;
+    txOther.vin.resize(1);
+    txOther.vout.push_back(CTxOut(nDenom + 1, script));
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, txOther), false, &walletdb));
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(CTxIn(txOther.GetHash(), 0), 0), -2);
+
+    pwalletMain->ClearPrivateSendRounds();
+    BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(CTxIn(txChild.GetHash(), 0), 0), 1);
+}
+
+BOOST_AUTO_TEST_CASE(available_coins_index)
+{
+    darkSendPool.InitDenominations();
+    CAmount nDenom = vecPrivateSendDenominations[1];
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    TestMemPoolEntryHelper entry;
+
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(pwalletMain->AddKeyPubKey(key, key.GetPubKey()));
+    CScript script = GetScriptForDestination(key.GetPubKey().GetID());
+
+    // not a coinbase, those have to mature first
+    CMutableTransaction txFund;
+    txFund.vin.push_back(CTxIn(uint256S("0x01"), 0));
+    txFund.vout.push_back(CTxOut(nDenom, script));
+    txFund.vout.push_back(CTxOut(PRIVATESEND_COLLATERAL * 2, script));
+    txFund.vout.push_back(CTxOut(nDenom + 1, script));
+    mempool.addUnchecked(txFund.GetHash(), entry.FromTx(txFund));
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, txFund), false, &walletdb));
+
+    vector<COutput> vCoins;
+    pwalletMain->AvailableCoins(vCoins, false, NULL, false, ONLY_DENOMINATED);
+    BOOST_CHECK_EQUAL(vCoins.size(), 1U);
+    pwalletMain->AvailableCoins(vCoins, false, NULL, false, ONLY_PRIVATESEND_COLLATERAL);
+    BOOST_REQUIRE_EQUAL(vCoins.size(), 1U);
+    BOOST_CHECK_EQUAL(vCoins[0].i, 1);
+    pwalletMain->AvailableCoins(vCoins, false, NULL, false, ALL_COINS);
+    BOOST_CHECK_EQUAL(vCoins.size(), 3U);
+
+    // spending the denomination takes it out
+    CMutableTransaction txSpend;
+    txSpend.vin.push_back(CTxIn(txFund.GetHash(), 0));
+    txSpend.vout.push_back(CTxOut(nDenom, CScript() << OP_TRUE));
+    BOOST_CHECK(pwalletMain->AddToWallet(CWalletTx(pwalletMain, txSpend), false, &walletdb));
+    pwalletMain->AvailableCoins(vCoins, false, NULL, false, ONLY_DENOMINATED);
+    BOOST_CHECK(vCoins.empty());
+    pwalletMain->AvailableCoins(vCoins, false, NULL, false, ALL_COINS);
+    BOOST_CHECK_EQUAL(vCoins.size(), 2U);
+
+    // and abandoning the spend puts it back
+    BOOST_CHECK(pwalletMain->AbandonTransaction(txSpend.GetHash()));
+    pwalletMain->AvailableCoins(vCoins, false, NULL, false, ONLY_DENOMINATED);
+    BOOST_CHECK_EQUAL(vCoins.size(), 1U);
+
+    // a rebuilt index is the same
+    pwalletMain->ReindexCoins();
+    pwalletMain->AvailableCoins(vCoins, false, NULL, false, ALL_COINS);
+    BOOST_CHECK_EQUAL(vCoins.size(), 3U);
+
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
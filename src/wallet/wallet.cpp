@@ -547,6 +547,8 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
     pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
     SyncMetaData(range);
+
+    UpdateCoinIndex(outpoint);
 }
 
 
@@ -718,6 +720,9 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         bool fInsertedNew = ret.second;
         if (fInsertedNew)
         {
+            // wallet txs spending this one may have got their rounds without it
+            InvalidatePrivateSendRounds(hash, pwalletdb);
+
             wtx.nTimeReceived = GetAdjustedTime();
             wtx.nOrderPos = IncOrderPosNext(pwalletdb);
             wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
@@ -769,6 +774,9 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
             AddToSpends(hash);
         }
 
+        for (unsigned int i = 0; i < wtx.vout.size(); i++)
+            UpdateCoinIndex(COutPoint(hash, i));
+
         bool fUpdated = false;
         if (!fInsertedNew)
         {
@@ -920,6 +928,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             {
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
+                UpdateCoinIndex(txin.prevout);
             }
         }
     }
@@ -984,6 +993,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             {
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
+                UpdateCoinIndex(txin.prevout);
             }
         }
     }
@@ -1047,7 +1057,7 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
+    AssertLockHeld(cs_wallet);
 
     if(nRounds >= 16) return 15; // 16 rounds max
 
@@ -1057,17 +1067,12 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
     const CWalletTx* wtx = GetWalletTx(hash);
     if(wtx != NULL)
     {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
+        std::map<COutPoint, int>::const_iterator it = mapPrivateSendRoundsCache.find(txin.prevout);
+        if(it != mapPrivateSendRoundsCache.end()) {
+            // computed before and the ancestry didn't change since, just return it
+            return it->second;
         }
 
-
         // bounds check
         if (nout >= wtx->vout.size()) {
             // should never actually hit this
@@ -1075,49 +1080,45 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
             return -4;
         }
 
+        int nRoundsRet;
         if (IsCollateralAmount(wtx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
-        //make sure the final output is non-denominate
-        if (!IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
-        bool fAllDenoms = true;
-        BOOST_FOREACH(CTxOut out, wtx->vout) {
-            fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
-        }
-
-        // this one is denominated but there is another non-denominated output found in the same tx
-        if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+            nRoundsRet = -3;
+        } else if (!IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
+            //make sure the final output is non-denominate
+            nRoundsRet = -2;
+        } else {
+            bool fAllDenoms = true;
+            BOOST_FOREACH(CTxOut out, wtx->vout) {
+                fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
+            }
 
-        int nShortest = -10; // an initial value, should be no way to get this by calculations
-        bool fDenomFound = false;
-        // only denoms here so let's look up
-        BOOST_FOREACH(CTxIn txinNext, wtx->vin) {
-            if (IsMine(txinNext)) {
-                int n = GetRealInputPrivateSendRounds(txinNext, nRounds + 1);
-                // denom found, find the shortest chain or initially assign nShortest with the first found value
-                if(n >= 0 && (n < nShortest || nShortest == -10)) {
-                    nShortest = n;
-                    fDenomFound = true;
+            if (!fAllDenoms) {
+                // this one is denominated but there is another non-denominated output found in the same tx
+                nRoundsRet = 0;
+            } else {
+                int nShortest = -10; // an initial value, should be no way to get this by calculations
+                bool fDenomFound = false;
+                // only denoms here so let's look up
+                BOOST_FOREACH(CTxIn txinNext, wtx->vin) {
+                    if (IsMine(txinNext)) {
+                        int n = GetRealInputPrivateSendRounds(txinNext, nRounds + 1);
+                        // denom found, find the shortest chain or initially assign nShortest with the first found value
+                        if(n >= 0 && (n < nShortest || nShortest == -10)) {
+                            nShortest = n;
+                            fDenomFound = true;
+                        }
+                    }
                 }
+                nRoundsRet = fDenomFound
+                        ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
+                        : 0;            // too bad, we are the fist one in that chain
             }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
-                ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
+
+        mapPrivateSendRoundsCache[txin.prevout] = nRoundsRet;
+        if (fFileBacked) setPrivateSendRoundsUnsaved.insert(txin.prevout);
+        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+        return nRoundsRet;
     }
 
     return nRounds - 1;
@@ -1128,9 +1129,95 @@ int CWallet::GetInputPrivateSendRounds(CTxIn txin) const
 {
     LOCK(cs_wallet);
     int realPrivateSendRounds = GetRealInputPrivateSendRounds(txin, 0);
+    FlushPrivateSendRounds();
     return realPrivateSendRounds > nPrivateSendRounds ? nPrivateSendRounds : realPrivateSendRounds;
 }
 
+void CWallet::FlushPrivateSendRounds() const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (setPrivateSendRoundsUnsaved.empty()) return;
+
+    // write them all in one transaction, keep them unsaved to retry later if that fails
+    CWalletDB walletdb(strWalletFile);
+    if (!walletdb.TxnBegin())
+        return;
+    BOOST_FOREACH(const COutPoint& outpoint, setPrivateSendRoundsUnsaved) {
+        std::map<COutPoint, int>::const_iterator it = mapPrivateSendRoundsCache.find(outpoint);
+        if (it != mapPrivateSendRoundsCache.end())
+            walletdb.WritePrivateSendRounds(outpoint, it->second);
+    }
+    if (!walletdb.TxnCommit()) {
+        LogPrintf("FlushPrivateSendRounds(): failed to write %d entries\n", setPrivateSendRoundsUnsaved.size());
+        return;
+    }
+    setPrivateSendRoundsUnsaved.clear();
+}
+
+void CWallet::LoadPrivateSendRounds(const COutPoint& outpoint, int nRounds)
+{
+    LOCK(cs_wallet);
+    mapPrivateSendRoundsCache[outpoint] = nRounds;
+}
+
+void CWallet::InvalidatePrivateSendRounds(const uint256& hashTx, CWalletDB* pwalletdb)
+{
+    AssertLockHeld(cs_wallet);
+
+    if (mapPrivateSendRoundsCache.empty()) return;
+
+    // rounds only depend on ancestors, walk the in-wallet descendants of hashTx
+    std::set<uint256> setDone;
+    std::vector<uint256> vecTodo(1, hashTx);
+    CWalletDB* pwalletdbOwned = NULL;
+    while (!vecTodo.empty()) {
+        uint256 hash = vecTodo.back();
+        vecTodo.pop_back();
+        if (!setDone.insert(hash).second) continue;
+
+        std::map<uint256, CWalletTx>::const_iterator itTx = mapWallet.find(hash);
+        if (itTx == mapWallet.end()) continue;
+
+        for (unsigned int i = 0; i < itTx->second.vout.size(); i++) {
+            std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(hash, i));
+            for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
+                vecTodo.push_back(it->second);
+            }
+            if (hash == hashTx) continue;
+
+            COutPoint outpoint(hash, i);
+            if (mapPrivateSendRoundsCache.erase(outpoint)) {
+                setPrivateSendRoundsUnsaved.erase(outpoint);
+                if (fFileBacked) {
+                    if (!pwalletdb)
+                        pwalletdb = pwalletdbOwned = new CWalletDB(strWalletFile);
+                    pwalletdb->ErasePrivateSendRounds(outpoint);
+                }
+            }
+        }
+    }
+    delete pwalletdbOwned;
+}
+
+void CWallet::ClearPrivateSendRounds()
+{
+    LOCK(cs_wallet);
+
+    if (fFileBacked) {
+        CWalletDB walletdb(strWalletFile);
+        bool fTxn = walletdb.TxnBegin();
+        for (std::map<COutPoint, int>::const_iterator it = mapPrivateSendRoundsCache.begin(); it != mapPrivateSendRoundsCache.end(); ++it) {
+            if (!setPrivateSendRoundsUnsaved.count(it->first))
+                walletdb.ErasePrivateSendRounds(it->first);
+        }
+        if (fTxn)
+            walletdb.TxnCommit();
+    }
+    mapPrivateSendRoundsCache.clear();
+    setPrivateSendRoundsUnsaved.clear();
+}
+
 bool CWallet::IsDenominated(const CTxIn &txin) const
 {
     LOCK(cs_wallet);
@@ -2079,64 +2166,143 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
     return nTotal;
 }
 
+void CWallet::UpdateCoinIndex(const COutPoint& outpoint)
+{
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(outpoint.hash);
+    if (mi == mapWallet.end() || outpoint.n >= mi->second.vout.size())
+        return;
+    const CTxOut& txout = mi->second.vout[outpoint.n];
+
+    bool fAvailable = IsMine(txout) != ISMINE_NO;
+    if (fAvailable) {
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(outpoint);
+        for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
+            map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+            if (mit == mapWallet.end())
+                continue;
+            // abandoned and conflicted txs don't spend their inputs, see IsSpent
+            const CWalletTx& wtxSpend = mit->second;
+            if (!wtxSpend.isAbandoned() && !(wtxSpend.nIndex == -1 && !wtxSpend.hashUnset())) {
+                fAvailable = false;
+                break;
+            }
+        }
+    }
+
+    if (fAvailable) {
+        mapCoinsByAmount[txout.nValue].insert(outpoint);
+        return;
+    }
+    map<CAmount, set<COutPoint> >::iterator it = mapCoinsByAmount.find(txout.nValue);
+    if (it == mapCoinsByAmount.end())
+        return;
+    it->second.erase(outpoint);
+    if (it->second.empty())
+        mapCoinsByAmount.erase(it);
+}
+
+void CWallet::ReindexCoins()
+{
+    LOCK(cs_wallet);
+    mapCoinsByAmount.clear();
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        for (unsigned int i = 0; i < it->second.vout.size(); i++)
+            UpdateCoinIndex(COutPoint(it->first, i));
+}
+
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
 {
     vCoins.clear();
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+
+        // only look at the outputs of the amounts we were asked for,
+        // ordered by tx like mapWallet so the txs are checked once each
+        set<COutPoint> setCoins;
+        if(nCoinType == ONLY_DENOMINATED) {
+            BOOST_FOREACH(CAmount nDenom, vecPrivateSendDenominations) {
+                map<CAmount, set<COutPoint> >::const_iterator it = mapCoinsByAmount.find(nDenom);
+                if(it != mapCoinsByAmount.end())
+                    setCoins.insert(it->second.begin(), it->second.end());
+            }
+        } else {
+            map<CAmount, set<COutPoint> >::const_iterator itBegin = mapCoinsByAmount.begin();
+            map<CAmount, set<COutPoint> >::const_iterator itEnd = mapCoinsByAmount.end();
+            if(nCoinType == ONLY_5000) {
+                itBegin = mapCoinsByAmount.lower_bound(5000*COIN);
+                itEnd = mapCoinsByAmount.upper_bound(5000*COIN);
+            } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+                itBegin = mapCoinsByAmount.lower_bound(PRIVATESEND_COLLATERAL * 2);
+                itEnd = mapCoinsByAmount.upper_bound(PRIVATESEND_COLLATERAL * 4);
+            }
+            for (map<CAmount, set<COutPoint> >::const_iterator it = itBegin; it != itEnd; ++it)
+                setCoins.insert(it->second.begin(), it->second.end());
+        }
+
+        const CWalletTx* pcoin = NULL;
+        bool fCoinUsable = false;
+        int nDepth = 0;
+        BOOST_FOREACH(const COutPoint& outpoint, setCoins)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            const uint256& wtxid = outpoint.hash;
+            if (pcoin == NULL || pcoin->GetHash() != wtxid) {
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+                assert(it != mapWallet.end());
+                pcoin = &(*it).second;
+                fCoinUsable = false;
+
+                if (!CheckFinalTx(*pcoin))
+                    continue;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                nDepth = pcoin->GetDepthInMainChain(false);
+                // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
+                if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
-            if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
-                continue;
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !pcoin->InMempool())
+                    continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
+                fCoinUsable = true;
+            }
+            if (!fCoinUsable)
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if(nCoinType == ONLY_DENOMINATED) {
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if(nCoinType == ONLY_NOT5000IFMN) {
-                    found = !(fMasterNode && pcoin->vout[i].nValue == 5000*COIN);
-                } else if(nCoinType == ONLY_NONDENOMINATED_NOT5000IFMN) {
-                    if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if(found && fMasterNode) found = pcoin->vout[i].nValue != 5000*COIN; // do not use Hot MN funds
-                } else if(nCoinType == ONLY_5000) {
-                    found = pcoin->vout[i].nValue == 5000*COIN;
-                } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
-                    found = IsCollateralAmount(pcoin->vout[i].nValue);
-                } else {
-                    found = true;
-                }
-                if(!found) continue;
-
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_5000) &&
-                    (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected((*it).first, i)))
-                        vCoins.push_back(COutput(pcoin, i, nDepth,
-                                                 ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                                  (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
+            unsigned int i = outpoint.n;
+            bool found = false;
+            if(nCoinType == ONLY_DENOMINATED) {
+                found = IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if(nCoinType == ONLY_NOT5000IFMN) {
+                found = !(fMasterNode && pcoin->vout[i].nValue == 5000*COIN);
+            } else if(nCoinType == ONLY_NONDENOMINATED_NOT5000IFMN) {
+                if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
+                found = !IsDenominatedAmount(pcoin->vout[i].nValue);
+                if(found && fMasterNode) found = pcoin->vout[i].nValue != 5000*COIN; // do not use Hot MN funds
+            } else if(nCoinType == ONLY_5000) {
+                found = pcoin->vout[i].nValue == 5000*COIN;
+            } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+                found = IsCollateralAmount(pcoin->vout[i].nValue);
+            } else {
+                found = true;
             }
+            if(!found) continue;
+
+            isminetype mine = IsMine(pcoin->vout[i]);
+            if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+                (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_5000) &&
+                (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
+                    vCoins.push_back(COutput(pcoin, i, nDepth,
+                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                              (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
         }
     }
 }
@@ -3348,6 +3514,24 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         return nLoadWalletRet;
     fFirstRunRet = !vchDefaultKey.IsValid();
 
+    {
+        LOCK(cs_wallet);
+        // only keep the rounds of outputs still in the wallet, e.g. after -zapwallettxes
+        CWalletDB walletdb(strWalletFile);
+        std::map<COutPoint, int>::iterator it = mapPrivateSendRoundsCache.begin();
+        while (it != mapPrivateSendRoundsCache.end()) {
+            if (mapWallet.count(it->first.hash)) {
+                ++it;
+                continue;
+            }
+            walletdb.ErasePrivateSendRounds(it->first);
+            mapPrivateSendRoundsCache.erase(it++);
+        }
+
+        // spends are only known once all txs are loaded
+        ReindexCoins();
+    }
+
     uiInterface.LoadWallet(this);
 
     return DB_LOAD_OK;
@@ -540,6 +540,18 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /**
+     * PrivateSend rounds of the wallet's outputs, filled by GetRealInputPrivateSendRounds and kept in
+     * the wallet file. Entries of outputs whose ancestry changes are dropped by InvalidatePrivateSendRounds.
+     */
+    mutable std::map<COutPoint, int> mapPrivateSendRoundsCache;
+    //! Cache entries not written to the wallet file yet
+    mutable std::set<COutPoint> setPrivateSendRoundsUnsaved;
+
+    /// Forget the rounds of the outputs of the wallet txs spending this tx, and of their descendants
+    void InvalidatePrivateSendRounds(const uint256& hashTx, CWalletDB* pwalletdb);
+    void FlushPrivateSendRounds() const;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -555,6 +567,16 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Our outputs by amount, so AvailableCoins only has to look at the outputs of the
+     * requested denominations. Outputs spent by a wallet tx which is neither abandoned
+     * nor conflicted are left out, every other check is still done by AvailableCoins.
+     */
+    std::map<CAmount, std::set<COutPoint> > mapCoinsByAmount;
+
+    /// Add the output to mapCoinsByAmount or remove it from there, depending on its current state
+    void UpdateCoinIndex(const COutPoint& outpoint);
+
 public:
     /*
      * Main wallet lock.
@@ -610,6 +632,9 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        mapPrivateSendRoundsCache.clear();
+        setPrivateSendRoundsUnsaved.clear();
+        mapCoinsByAmount.clear();
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -636,6 +661,8 @@ public:
     //! check whether we are allowed to upgrade (or already support) to the named feature
     bool CanSupportFeature(enum WalletFeature wf) { AssertLockHeld(cs_wallet); return nWalletMaxVersion >= wf; }
 
+    //! Rebuild the index of our outputs, e.g. because outputs may have become ours
+    void ReindexCoins();
     /**
      * populate vCoins with vector of available COutputs.
      */
@@ -667,6 +694,10 @@ public:
     int GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const;
     // respect current settings
     int GetInputPrivateSendRounds(CTxIn txin) const;
+    //! Adds a cached rounds value, without saving it to disk
+    void LoadPrivateSendRounds(const COutPoint& outpoint, int nRounds);
+    //! Forget all cached rounds, e.g. because inputs may have become ours
+    void ClearPrivateSendRounds();
 
     bool IsDenominated(const CTxIn &txin) const;
     bool IsDenominatedAmount(CAmount nInputAmount) const;